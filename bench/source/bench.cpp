@@ -0,0 +1,372 @@
+#include <ascopet/ascopet.hpp>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+using Ns    = std::chrono::duration<double, std::nano>;
+using Us    = std::chrono::duration<double, std::micro>;
+
+// No println in C++20 yet
+template <typename... Args>
+void println(std::ostream& out, std::format_string<Args...> fmt, Args&&... args)
+{
+    out << std::format(fmt, std::forward<Args>(args)...) << '\n';
+}
+
+struct Config
+{
+    std::size_t threads;
+    std::size_t buffer_capacity;
+    std::size_t record_capacity;
+    std::size_t names;
+    std::size_t poll_interval_us;
+    std::size_t scopes;    // per thread
+};
+
+// plain data so it can be sent through a pipe from the child process
+struct Result
+{
+    double        overhead_ns;    // per scope, averaged over threads
+    std::uint64_t drain_polls;
+    double        drain_mean_us;
+    double        drain_max_us;
+    double        report_us;
+    double        aggregate_report_us;
+    std::uint64_t produced;
+    std::uint64_t recorded;
+};
+
+struct Options
+{
+    std::vector<std::size_t> threads;
+    std::vector<std::size_t> buffer_capacity  = { 65536 };
+    std::vector<std::size_t> record_capacity  = { 1024 };
+    std::vector<std::size_t> names            = { 16 };
+    std::vector<std::size_t> poll_interval_us = { 10'000 };
+    std::size_t              scopes           = 1'000'000;
+    std::size_t              report_repeat    = 10;
+    std::string              format           = "csv";
+    std::string              output;
+};
+
+template <typename Fn>
+double average_us(std::size_t repeat, Fn&& fn)
+{
+    auto start = Clock::now();
+    for (auto i = 0u; i < repeat; ++i) {
+        fn();
+    }
+    return Us{ Clock::now() - start }.count() / static_cast<double>(repeat);
+}
+
+Result run(const Config& config, std::size_t report_repeat)
+{
+    auto poll_interval = std::chrono::microseconds{ config.poll_interval_us };
+
+    auto ascopet = ascopet::init({
+        .immediately_start = true,
+        .poll_interval     = poll_interval,
+        .record_capacity   = config.record_capacity,
+        .buffer_capacity   = config.buffer_capacity,
+    });
+
+    auto sites = std::vector<ascopet::SiteId>{};
+    for (auto i = 0u; i < config.names; ++i) {
+        sites.push_back(ascopet::register_site(std::format("bench/{}", i)));
+    }
+
+    auto per_scope = std::vector<double>(config.threads);
+
+    auto producer = [&](std::size_t index) {
+        auto site  = std::size_t{ 0 };
+        auto start = Clock::now();
+        for (auto i = 0u; i < config.scopes; ++i) {
+            auto trace = ascopet::trace(sites[site]);
+            if (++site == sites.size()) {
+                site = 0;
+            }
+        }
+        per_scope[index] = Ns{ Clock::now() - start }.count() / static_cast<double>(config.scopes);
+    };
+
+    {
+        auto threads = std::vector<std::jthread>{};
+        for (auto i = 0u; i < config.threads; ++i) {
+            threads.emplace_back(producer, i);
+        }
+    }
+
+    // the worker drains what the producers left in their buffers once it has settled their exit
+    auto settled = [&] {
+        auto report = ascopet->thread_report();
+        return std::ranges::none_of(report, [](const auto& entry) { return entry.second.alive; });
+    };
+    while (not settled()) {
+        std::this_thread::sleep_for(poll_interval);
+    }
+
+    auto report_us    = average_us(report_repeat, [&] { auto report = ascopet->report(); });
+    auto aggregate_us = average_us(report_repeat, [&] { auto report = ascopet->aggregate_report(); });
+
+    auto recorded = std::uint64_t{ 0 };
+    for (const auto& [_, stat] : ascopet->aggregate_report()) {
+        recorded += stat.count;
+    }
+
+    auto overhead = 0.0;
+    for (auto value : per_scope) {
+        overhead += value / static_cast<double>(config.threads);
+    }
+
+    auto drain = ascopet->drain_stat();
+
+    return {
+        .overhead_ns         = overhead,
+        .drain_polls         = drain.polls,
+        .drain_mean_us       = drain.polls ? Us{ drain.busy }.count() / static_cast<double>(drain.polls) : 0.0,
+        .drain_max_us        = Us{ drain.max_busy }.count(),
+        .report_us           = report_us,
+        .aggregate_report_us = aggregate_us,
+        .produced            = config.threads * config.scopes,
+        .recorded            = recorded,
+    };
+}
+
+// Ascopet can only be initialized once per process, so each configuration runs in its own child process
+bool run_isolated(const Config& config, std::size_t report_repeat, Result& result)
+{
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return false;
+    }
+
+    auto pid = fork();
+    if (pid < 0) {
+        return false;
+    } else if (pid == 0) {
+        close(fds[0]);
+        auto child_result = run(config, report_repeat);
+        auto written      = write(fds[1], &child_result, sizeof(Result));
+        _exit(written == sizeof(Result) ? 0 : 1);
+    }
+
+    close(fds[1]);
+    auto bytes = read(fds[0], &result, sizeof(Result));
+    close(fds[0]);
+
+    auto status = 0;
+    waitpid(pid, &status, 0);
+    return bytes == sizeof(Result) and WIFEXITED(status) and WEXITSTATUS(status) == 0;
+}
+
+bool parse_list(std::string_view str, std::vector<std::size_t>& out)
+{
+    out.clear();
+    while (not str.empty()) {
+        auto comma = str.find(',');
+        auto item  = str.substr(0, comma);
+        auto value = std::size_t{};
+
+        auto [ptr, ec] = std::from_chars(item.data(), item.data() + item.size(), value);
+        if (ec != std::errc{} or ptr != item.data() + item.size() or value == 0) {
+            return false;
+        }
+        out.push_back(value);
+
+        str = comma == std::string_view::npos ? std::string_view{} : str.substr(comma + 1);
+    }
+    return not out.empty();
+}
+
+void print_usage(const char* program)
+{
+    println(
+        std::cerr,
+        "usage: {} [--threads LIST] [--buffer LIST] [--record LIST] [--names LIST] [--poll-us LIST]\n"
+        "       [--scopes N] [--report-repeat N] [--format csv|json] [--output PATH]\n\n"
+        "LIST is a comma separated list of positive integers, every combination of them is measured.\n"
+        "--threads defaults to powers of two up to the number of cores.",
+        program
+    );
+}
+
+bool parse_options(int argc, char** argv, Options& options)
+{
+    for (auto i = 1; i < argc; ++i) {
+        auto arg = std::string_view{ argv[i] };
+        if (arg == "--help" or i + 1 >= argc) {
+            return false;
+        }
+
+        auto value  = std::string_view{ argv[++i] };
+        auto ok     = true;
+        auto single = std::vector<std::size_t>{};
+
+        if (arg == "--threads") {
+            ok = parse_list(value, options.threads);
+        } else if (arg == "--buffer") {
+            ok = parse_list(value, options.buffer_capacity);
+        } else if (arg == "--record") {
+            ok = parse_list(value, options.record_capacity);
+        } else if (arg == "--names") {
+            ok = parse_list(value, options.names);
+        } else if (arg == "--poll-us") {
+            ok = parse_list(value, options.poll_interval_us);
+        } else if (arg == "--scopes") {
+            ok = parse_list(value, single) and single.size() == 1;
+            options.scopes = ok ? single.front() : 0;
+        } else if (arg == "--report-repeat") {
+            ok = parse_list(value, single) and single.size() == 1;
+            options.report_repeat = ok ? single.front() : 0;
+        } else if (arg == "--format" and (value == "csv" or value == "json")) {
+            options.format = value;
+        } else if (arg == "--output") {
+            options.output = value;
+        } else {
+            ok = false;
+        }
+
+        if (not ok) {
+            return false;
+        }
+    }
+
+    if (options.threads.empty()) {
+        auto cores = std::max(std::thread::hardware_concurrency(), 1u);
+        for (auto threads = 1u; threads < cores; threads *= 2) {
+            options.threads.push_back(threads);
+        }
+        options.threads.push_back(cores);
+    }
+
+    return true;
+}
+
+std::vector<Config> configs(const Options& options)
+{
+    auto configs = std::vector<Config>{};
+    for (auto threads : options.threads) {
+        for (auto buffer : options.buffer_capacity) {
+            for (auto record : options.record_capacity) {
+                for (auto names : options.names) {
+                    for (auto poll : options.poll_interval_us) {
+                        configs.push_back({ threads, buffer, record, names, poll, options.scopes });
+                    }
+                }
+            }
+        }
+    }
+    return configs;
+}
+
+void write_csv(std::ostream& out, const std::vector<std::pair<Config, Result>>& results)
+{
+    println(
+        out,
+        "threads,buffer_capacity,record_capacity,names,poll_interval_us,scopes_per_thread,"
+        "overhead_ns,drain_polls,drain_mean_us,drain_max_us,report_us,aggregate_report_us,"
+        "produced,recorded,lost_rate"
+    );
+    for (const auto& [c, r] : results) {
+        auto lost_rate = 1.0 - static_cast<double>(r.recorded) / static_cast<double>(r.produced);
+        println(
+            out,
+            "{},{},{},{},{},{},{:.3f},{},{:.3f},{:.3f},{:.3f},{:.3f},{},{},{:.6f}",
+            c.threads,
+            c.buffer_capacity,
+            c.record_capacity,
+            c.names,
+            c.poll_interval_us,
+            c.scopes,
+            r.overhead_ns,
+            r.drain_polls,
+            r.drain_mean_us,
+            r.drain_max_us,
+            r.report_us,
+            r.aggregate_report_us,
+            r.produced,
+            r.recorded,
+            lost_rate
+        );
+    }
+}
+
+void write_json(std::ostream& out, const std::vector<std::pair<Config, Result>>& results)
+{
+    println(out, "[");
+    for (auto i = 0u; i < results.size(); ++i) {
+        const auto& [c, r] = results[i];
+        auto lost_rate     = 1.0 - static_cast<double>(r.recorded) / static_cast<double>(r.produced);
+        println(
+            out,
+            "  {{\"threads\": {}, \"buffer_capacity\": {}, \"record_capacity\": {}, \"names\": {}, "
+            "\"poll_interval_us\": {}, \"scopes_per_thread\": {}, \"overhead_ns\": {:.3f}, \"drain_polls\": {}, "
+            "\"drain_mean_us\": {:.3f}, \"drain_max_us\": {:.3f}, \"report_us\": {:.3f}, "
+            "\"aggregate_report_us\": {:.3f}, \"produced\": {}, \"recorded\": {}, \"lost_rate\": {:.6f}}}{}",
+            c.threads,
+            c.buffer_capacity,
+            c.record_capacity,
+            c.names,
+            c.poll_interval_us,
+            c.scopes,
+            r.overhead_ns,
+            r.drain_polls,
+            r.drain_mean_us,
+            r.drain_max_us,
+            r.report_us,
+            r.aggregate_report_us,
+            r.produced,
+            r.recorded,
+            lost_rate,
+            i + 1 < results.size() ? "," : ""
+        );
+    }
+    println(out, "]");
+}
+
+int main(int argc, char** argv)
+{
+    auto options = Options{};
+    if (not parse_options(argc, argv, options)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    auto results = std::vector<std::pair<Config, Result>>{};
+    for (const auto& config : configs(options)) {
+        auto result = Result{};
+        if (not run_isolated(config, options.report_repeat, result)) {
+            println(std::cerr, "run failed: threads={} buffer={}", config.threads, config.buffer_capacity);
+            return 1;
+        }
+        results.emplace_back(config, result);
+    }
+
+    auto file = std::ofstream{};
+    if (not options.output.empty()) {
+        file.open(options.output);
+        if (not file) {
+            println(std::cerr, "can't open {}", options.output);
+            return 1;
+        }
+    }
+
+    auto& out = options.output.empty() ? std::cout : file;
+    if (options.format == "json") {
+        write_json(out, results);
+    } else {
+        write_csv(out, results);
+    }
+}
@@ -0,0 +1,77 @@
+#include <ascopet/ascopet.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <format>
+#include <string>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+using Clock = std::chrono::steady_clock;
+using Ns    = std::chrono::duration<double, std::nano>;
+
+// No println in C++20 yet
+template <typename... Args>
+void println(std::format_string<Args...> fmt, Args&&... args)
+{
+    std::puts(std::format(fmt, std::forward<Args>(args)...).c_str());
+}
+
+// average time per iteration of an empty traced scope, i.e. the tracer overhead
+template <typename Fn>
+void measure(std::string_view label, std::size_t count, Fn&& fn)
+{
+    // warm up: registers the site and creates the thread's buffer
+    fn();
+
+    auto start = Clock::now();
+    for (auto i = 0u; i < count; ++i) {
+        fn();
+    }
+    auto per_scope = Ns{ Clock::now() - start } / static_cast<double>(count);
+
+    println("{:<28} {:>8.2f} ns/scope", label, per_scope.count());
+
+    // let the worker drain so the next measurement starts with an empty buffer
+    std::this_thread::sleep_for(10ms);
+}
+
+int main()
+{
+    static constexpr auto count = 10'000'000ull;
+
+    auto ascopet = ascopet::init({
+        .immediately_start = true,
+        .poll_interval     = 1ms,
+        .record_capacity   = 1024,
+        .buffer_capacity   = 1 << 20,    // big enough to never drop at this rate
+    });
+
+    const auto site    = ascopet::register_site("trace(site)");
+    const auto dynamic = std::string{ "trace(intern(name))" };    // not a literal, so its address says nothing
+
+    println("{:-^50}", "running");
+    measure("trace<\"name\">()", count, [] { auto trace = ascopet::trace<"trace<name>">(); });
+    measure("ASCOPET_TRACE(\"name\")", count, [] { ASCOPET_TRACE("ASCOPET_TRACE"); });
+    measure("trace(site)", count, [&] { auto trace = ascopet::trace(site); });
+    measure("trace(\"name\")", count, [] { auto trace = ascopet::trace("trace(name)"); });
+    measure("trace(intern(name))", count, [&] { auto trace = ascopet::trace(ascopet::intern(dynamic)); });
+    measure("trace()", count, [] { auto trace = ascopet::trace(); });
+    measure("ASCOPET_TRACE_SERIALIZED", count, [] { ASCOPET_TRACE_SERIALIZED("ASCOPET_TRACE_SERIALIZED"); });
+
+    println("{:-^50}", "paused");
+    ascopet->pause_tracing();
+    measure("trace<\"name\">()", count, [] { auto trace = ascopet::trace<"trace<name>">(); });
+    ascopet->start_tracing();
+
+    println("{:-^50}", "calibrated");
+    println("{:<28} {:>8}", "overhead", ascopet->overhead());
+    println("{:<28} {:>8}", "overhead (serialized)", ascopet->overhead(ascopet::Timing::serialized));
+
+    println("{:-^50}", "recorded");
+    std::this_thread::sleep_for(10ms);
+    for (const auto& [name, stat] : ascopet->aggregate_report()) {
+        println("{:<28} {:>8} records | dur mean: {}", name, stat.count, stat.duration.mean);
+    }
+}
@@ -0,0 +1,108 @@
+// the kernel is internal to the library, its header is in the source directory
+#include "kernel.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <format>
+#include <random>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+using Ns    = std::chrono::duration<double, std::nano>;
+
+// No println in C++20 yet
+template <typename... Args>
+void println(std::format_string<Args...> fmt, Args&&... args)
+{
+    std::puts(std::format(fmt, std::forward<Args>(args)...).c_str());
+}
+
+// keeps the optimizer from dropping the measured work
+template <typename T>
+void keep(const T& value)
+{
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+template <typename Fn>
+void measure(std::string_view label, std::size_t values, std::size_t repeat, Fn&& fn)
+{
+    fn();    // warm up
+
+    auto start = Clock::now();
+    for (auto i = 0u; i < repeat; ++i) {
+        fn();
+    }
+    auto per_value = Ns{ Clock::now() - start } / static_cast<double>(values * repeat);
+
+    println("{:<36} {:>8.3f} ns/value", label, per_value.count());
+}
+
+int main()
+{
+    constexpr auto count    = std::size_t{ 1 } << 16;    // a full record window of a busy entry
+    constexpr auto repeat   = std::size_t{ 2000 };
+    constexpr auto overhead = std::uint64_t{ 40 };
+
+    // only known at runtime in the library, don't let the compiler turn the division into a multiplication
+    auto freq = std::uint64_t{ 2'500'000'000 };
+    keep(freq);
+
+    // lognormal durations around ~100 ticks, starts 1000 ticks apart
+    auto rng    = std::mt19937_64{ 42 };
+    auto dist   = std::lognormal_distribution<double>{ 4.6, 0.5 };
+    auto starts = std::vector<std::uint64_t>(count);
+    auto ends   = std::vector<std::uint64_t>(count);
+    for (auto i = 0u; i < count; ++i) {
+        starts[i] = 1'000'000 + i * std::uint64_t{ 1000 };
+        ends[i]   = starts[i] + static_cast<std::uint64_t>(dist(rng));
+    }
+
+    const auto* a = starts.data();
+    const auto* b = ends.data();
+
+    println("{:-^56}", " stats over a span ");
+    println("avx2 available: {}", ascopet::kernel::has_avx2());
+
+    measure("per-record RunningStat::add", count, repeat, [&] {
+        auto stat = ascopet::RunningStat{};
+        for (auto i = 0u; i < count; ++i) {
+            stat.add(ascopet::kernel::delta(a[i], b[i], overhead));
+        }
+        keep(stat);
+    });
+
+    auto pivot = static_cast<double>(ascopet::kernel::delta(a[0], b[0], overhead));
+
+    measure("kernel::delta_stat_scalar", count, repeat, [&] {
+        keep(ascopet::kernel::delta_stat_scalar(a, b, count, overhead, pivot));
+    });
+    measure("kernel::delta_stat_avx2", count, repeat, [&] {
+        keep(ascopet::kernel::delta_stat_avx2(a, b, count, overhead, pivot));
+    });
+
+    println("{:-^56}", " tick to ns conversion ");
+
+    auto ns = std::vector<ascopet::Duration>(count);
+
+    measure("(end - start) * 1e9 / freq", count, repeat, [&] {
+        for (auto i = 0u; i < count; ++i) {
+            ns[i] = ascopet::Duration{ (b[i] - a[i]) * ascopet::Duration::period::den / freq };
+        }
+        keep(ns);
+    });
+
+    auto scale = ascopet::kernel::TickScale{ freq };
+    measure("TickScale::to_duration", count, repeat, [&] {
+        for (auto i = 0u; i < count; ++i) {
+            ns[i] = scale.to_duration(b[i] - a[i]);
+        }
+        keep(ns);
+    });
+
+    // the division overflows here, the multiply-shift doesn't
+    auto ten_seconds = std::uint64_t{ 10 } * freq;
+    println("");
+    println("10s of ticks with division: {}", ascopet::Duration{ ten_seconds * ascopet::Duration::period::den / freq });
+    println("10s of ticks with TickScale: {}", scale.to_duration(ten_seconds));
+}
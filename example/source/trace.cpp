@@ -23,25 +23,29 @@ void print_report(std::thread::id id, const ascopet::StrMap<ascopet::TimingStat>
 
     println("\tThread {}", std::hash<decltype(id)>{}(id));    // only in C++23 thread::id has format spec
     for (const auto& [name, timing] : timings) {
-        auto [dur, intvl, count] = timing;
+        auto [dur, intvl, count, sampled, overwritten] = timing;
         println("\t> {}", name);
         println(
-            "\t\t> Dur   [ mean: {} (+/- {}) | median: {} | min: {} | max: {} ]",
+            "\t\t> Dur   [ mean: {} (+/- {}) | median: {} | min: {} | max: {} | p99: {} | p99.9: {} ]",
             to_duration(dur.mean),
             to_duration(dur.stdev),
             to_duration(dur.median),
             to_duration(dur.min),
-            to_duration(dur.max)
+            to_duration(dur.max),
+            to_duration(dur.p99),
+            to_duration(dur.p999)
         );
         println(
-            "\t\t> Intvl [ mean: {} (+/- {}) | median: {} | min: {} | max: {} ]",
+            "\t\t> Intvl [ mean: {} (+/- {}) | median: {} | min: {} | max: {} | p99: {} | p99.9: {} ]",
             to_duration(intvl.mean),
             to_duration(intvl.stdev),
             to_duration(intvl.median),
             to_duration(intvl.min),
-            to_duration(intvl.max)
+            to_duration(intvl.max),
+            to_duration(intvl.p99),
+            to_duration(intvl.p999)
         );
-        println("\t\t> Count: {}", count);
+        println("\t\t> Count: {} ({} sampled, {} out of the record window)", count, sampled, overwritten);
     }
 }
 
@@ -110,7 +114,7 @@ void contention_test(std::size_t count)
 
     if (auto ascopet = ascopet::instance(); ascopet and ascopet->is_tracing()) {
         println("\ncontention_test:");
-        if (auto report = ascopet->report(); report.empty()) {
+        if (auto report = ascopet->report(true); report.empty()) {
             println("\nempty");
         } else {
             for (const auto& [id, traces] : report) {
@@ -131,7 +135,7 @@ void sleep_test()
 
     auto sleep_func = [](std::chrono::milliseconds dur) {
         for (auto i = 0; i < 10000 / dur.count(); ++i) {
-            auto trace = ascopet::trace("sleep");
+            ASCOPET_TRACE("sleep");
             std::this_thread::sleep_for(dur);
         }
     };
@@ -146,7 +150,7 @@ void sleep_test()
         sleep_func(dur);
 
         const auto id = std::this_thread::get_id();
-        print_report<std::chrono::duration<float, std::milli>>(id, ascopet->report()[id]);
+        print_report<std::chrono::duration<float, std::milli>>(id, ascopet->report(true)[id]);
     }
 }
 
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace ascopet
+{
+    // Bump allocator handing out fixed-size slabs of ticks carved from a few large blocks. Slabs can't be freed
+    // one by one; reset() makes every slab available again while keeping the blocks, so a list that is cleared
+    // and refilled doesn't go back to the heap.
+    class SlabArena
+    {
+    public:
+        // blocks start small so a list with a few entries stays small, then grow up to this size
+        static constexpr std::size_t max_block_bytes = std::size_t{ 1 } << 20;
+
+        SlabArena(std::size_t slab_size)
+            : m_slab_size{ slab_size }
+        {
+            assert(slab_size > 0);
+        }
+
+        SlabArena(SlabArena&&)            = default;
+        SlabArena& operator=(SlabArena&&) = default;
+
+        SlabArena(const SlabArena&)            = delete;
+        SlabArena& operator=(const SlabArena&) = delete;
+
+        // the content of the slab is uninitialized
+        std::uint64_t* acquire()
+        {
+            while (m_block < m_blocks.size() and m_used == m_blocks[m_block].slabs) {
+                ++m_block;
+                m_used = 0;
+            }
+
+            if (m_block == m_blocks.size()) {
+                auto max_slabs = std::max(max_block_bytes / (m_slab_size * sizeof(std::uint64_t)), std::size_t{ 1 });
+                auto slabs     = std::min(m_blocks.empty() ? std::size_t{ 4 } : m_blocks.back().slabs * 2, max_slabs);
+                m_blocks.push_back({ std::make_unique_for_overwrite<std::uint64_t[]>(slabs * m_slab_size), slabs });
+                m_used = 0;
+            }
+
+            return m_blocks[m_block].data.get() + m_used++ * m_slab_size;
+        }
+
+        // invalidates every slab acquired so far
+        void reset()
+        {
+            m_block = 0;
+            m_used  = 0;
+        }
+
+        std::size_t slab_size() const { return m_slab_size; }
+
+    private:
+        struct Block
+        {
+            std::unique_ptr<std::uint64_t[]> data;
+            std::size_t                      slabs;
+        };
+
+        std::size_t        m_slab_size;
+        std::vector<Block> m_blocks;
+        std::size_t        m_block = 0;    // block the next slab is carved from
+        std::size_t        m_used  = 0;    // slabs already carved from it
+    };
+}
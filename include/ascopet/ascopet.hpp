@@ -1,83 +1,423 @@
 #pragma once
 
+#include "ascopet/arena.hpp"
+#include "ascopet/calltree.hpp"
+#include "ascopet/clock.hpp"
 #include "ascopet/common.hpp"
+#include "ascopet/localbuf.hpp"
 #include "ascopet/ringbuf.hpp"
+#include "ascopet/stat.hpp"
+#include "ascopet/timewindow.hpp"
+#include "ascopet/window.hpp"
 
 #include <atomic>
 #include <chrono>
 #include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <shared_mutex>
 #include <source_location>
+#include <span>
+#include <string>
+#include <string_view>
 #include <stop_token>
 #include <thread>
+#include <vector>
+
+// Most detailed Level whose traces are compiled in, the traces of a more detailed level compile to nothing.
+// 0 removes every trace<Name>() and ASCOPET_TRACE, the runtime-named traces are always kept.
+#if not defined(ASCOPET_LEVEL)
+#    define ASCOPET_LEVEL 3
+#endif
 
 // ascopet -> a-scope-t: asynchronous scope timer
 namespace ascopet
 {
-    class LocalBuf;
-
     using Duration = std::chrono::duration<long, std::nano>;
 
+    // sub-ns precision for stats, scopes of a few ns would lose most of their resolution to truncation
+    using StatDuration = std::chrono::duration<double, std::nano>;
+
     struct TimingStat
     {
+        // quantiles are estimated from a histogram with bounded relative error (see Histogram) unless exact
+        // values were requested, in which case the median is computed from the record window
         struct Stat
         {
-            Duration mean;
-            Duration median;
-            Duration stdev;
-            Duration min;
-            Duration max;
+            StatDuration mean;
+            StatDuration median;
+            StatDuration stdev;
+            StatDuration min;
+            StatDuration max;
+            StatDuration p90;
+            StatDuration p99;
+            StatDuration p999;
         };
 
+        // with a sampled site, `count` is the number of calls and `sampled` the number of them that were timed,
+        // which the duration and interval stats are estimated from
         Stat        duration;
         Stat        interval;
         std::size_t count;
+        std::size_t sampled;
+        std::size_t overwritten;    // sampled records that no longer fit in the record window
+    };
+
+    // Counter increments, gauge samples and instant events of a site, see ascopet::count. The rate is per second
+    // between the first and the last record: the sum of the increments for a counter, the number of records
+    // otherwise.
+    struct CounterStat
+    {
+        // increments attached to a scope with Tracer::count, over the time spent in the scopes that got any
+        struct Throughput
+        {
+            std::uint64_t sum;
+            StatDuration  time;
+            double        per_second;
+        };
+
+        NamedRecord::Kind  kind;
+        std::size_t        count;
+        std::uint64_t      sum;    // of the values, 0 for instant events
+        std::uint64_t      last;
+        std::uint64_t      min;
+        std::uint64_t      max;
+        double             mean;
+        double             rate;
+        StrMap<Throughput> scopes;    // by name of the enclosing scope
+    };
+
+    struct QuantileStat
+    {
+        std::vector<StatDuration> duration;    // one value for each requested quantile, in the same order
+        std::vector<StatDuration> interval;
     };
 
     class TimingList
     {
     public:
-        TimingList(std::size_t capacity);
+        // how far a consumer has read the records of a list, see stat_since
+        struct Cursor
+        {
+            std::uint64_t              list       = 0;
+            std::uint64_t              generation = 0;
+            std::vector<std::uint64_t> seen;     // records, indexed by SiteId
+            std::vector<std::uint64_t> calls;    // same for the calls
+            std::vector<std::uint64_t> lost;     // same for the records absorbed as overwritten
+        };
 
-        void push_back(const NamedRecord& record);
+        // `windows` are the spans in ticks of the time windows kept for every entry, see TimeWindow; the call
+        // tree is only built when `call_tree` is set
+        TimingList(
+            std::size_t                capacity,
+            std::vector<std::uint64_t> windows        = {},
+            std::size_t                window_buckets = 1,
+            bool                       call_tree      = false
+        );
+
+        // `overhead` ticks are subtracted from the duration of the record, clamped at zero. The record is only
+        // accounted in the stats on the next flush, which folds every pushed record in one pass per entry. The
+        // calls skipped before a sampled record (see NamedRecord::weight) are only counted.
+        void push_back(const NamedRecord& record, std::uint64_t overhead = 0);
+        void flush();
         void clear(bool remove_entries);
         void resize(std::size_t new_capacity);
 
-        StrMap<TimingStat>      stat(std::uint64_t freq) const;
+        // Merges the stats of another flushed list, like the one of an exited thread, into this one: summaries,
+        // counts, time windows, call tree and the records still in its windows, which are appended to the windows
+        // of this list as already folded. Cursors of this list see everything the other list ever pushed as new.
+        void absorb(const TimingList& other);
+
+        // stats cover every record pushed since the last clear; the exact median is computed from the record
+        // window only when `exact` is set
+        StrMap<TimingStat>      stat(std::uint64_t freq, bool exact = false) const;
+        StrMap<QuantileStat>    quantiles(std::uint64_t freq, std::span<const double> quantiles) const;
         StrMap<RingBuf<Record>> records() const;
+        StrMap<CounterStat>     counter_stat(std::uint64_t freq) const;
+
+        // stats over only the records pushed since the cursor last read this list, computed from the record
+        // window (older records that fell out of it are only counted); entries with no new records are left
+        // out and the cursor is moved past everything read
+        StrMap<TimingStat> stat_since(std::uint64_t freq, Cursor& cursor) const;
+
+        // stats over the records that started within the `window`-th time window ending at `now`, entries
+        // without any are left out
+        StrMap<TimingStat> window_stat(std::uint64_t freq, std::size_t window, std::uint64_t now) const;
+
+        // merge the summaries of a site into the given ones and add its skipped calls to `skipped`, returns the
+        // number of its records still in the record window (0 if this list has no such entry)
+        std::size_t merge_summary(SiteId site, Summary& duration, Summary& interval, std::uint64_t& skipped) const;
+
+        // one past the largest site id this list may hold an entry for
+        std::size_t site_bound() const;
+
+        const CallTree& calls() const { return m_calls; }
+
+    private:
+        struct Entry
+        {
+            RecordWindow                 records;
+            Summary                      duration;
+            Summary                      interval;
+            std::optional<std::uint64_t> last_start;      // of the last folded record
+            std::size_t                  pending  = 0;    // latest records in the window not folded yet
+            std::uint64_t                overhead = 0;    // of the pending records
+            std::uint64_t                seq      = 0;    // records ever pushed, not reset by clear
+            std::uint64_t                calls    = 0;    // calls ever pushed (records and their skipped calls)
+            std::uint64_t                lost     = 0;    // records absorbed after they left the other window
+            std::uint64_t                skipped  = 0;    // calls skipped by sampling since the last clear
+            std::vector<TimeWindow>      windows;         // one for each of m_windows
+
+            // overhead of the records in the window as (seq of the first record it applies to, overhead), oldest
+            // first; there is more than one only when the site is traced with both timings
+            std::vector<std::pair<std::uint64_t, std::uint64_t>> overheads;
+        };
+
+        // counter, gauge or instant events of a site
+        struct Events
+        {
+            struct Attached
+            {
+                SiteId        scope;
+                std::uint64_t sum;
+                std::uint64_t ticks;
+            };
+
+            NamedRecord::Kind     kind        = NamedRecord::scope;    // of the first record, sites shouldn't mix them
+            RunningStat           values;
+            std::uint64_t         last        = 0;
+            std::uint64_t         first_stamp = 0;
+            std::uint64_t         last_stamp  = 0;
+            std::vector<Attached> scopes;
+        };
+
+        Entry& entry(SiteId site);
+        void   fold(Entry& entry);
+
+        void push_event(const NamedRecord& record);
+        void settle_attached(SiteId scope, std::uint8_t depth, std::uint64_t duration);
+
+        std::uint64_t                     m_id;                // changes when the entries are removed
+        std::uint64_t                     m_generation = 0;    // records ever pushed to any entry
+        std::size_t                       m_capacity;
+        std::vector<std::uint64_t>        m_windows;           // spans in ticks
+        std::size_t                       m_window_buckets;
+        SlabArena                         m_arena;             // storage of every entry's record window
+        std::vector<std::optional<Entry>> m_entries;           // indexed by SiteId
+        std::vector<SiteId>               m_pending;           // entries with pending records
+        bool                              m_call_tree;
+        CallTree                          m_calls;
+
+        std::vector<std::optional<Events>> m_events;    // indexed by SiteId
+
+        // increments attached to a scope still open, by depth of the scope: (counter, amount) merged by counter
+        std::vector<std::vector<std::pair<SiteId, std::uint64_t>>> m_attached;
+    };
+
+    // the whole traced scope is inlined: a timestamp read on construction, another one and a push into the
+    // thread's buffer on destruction; a call skipped by sampling has no buffer and does nothing
+    template <Timing T>
+    class [[nodiscard]] BasicTracer
+    {
+    public:
+        ~BasicTracer()
+        {
+            if (m_buffer) {
+                auto end = end_stamp<T>();
+                m_buffer->leave();
+                m_buffer->add_record({
+                    .site   = m_site,
+                    .flags  = flags,
+                    .depth  = m_depth,
+                    .weight = m_weight,
+                    .start  = m_start,
+                    .end    = end,
+                });
+            }
+        }
+
+        BasicTracer(LocalBuf* buffer, SiteId site, std::uint16_t weight = 1) noexcept
+            : m_buffer{ buffer }
+            , m_site{ site }
+            , m_depth{ buffer ? buffer->enter() : std::uint8_t{ 0 } }
+            , m_weight{ weight }
+            , m_start{ buffer ? start_stamp<T>() : 0 }
+        {
+        }
+
+        BasicTracer(BasicTracer&&)            = delete;
+        BasicTracer& operator=(BasicTracer&&) = delete;
+
+        BasicTracer(const BasicTracer&)            = delete;
+        BasicTracer& operator=(const BasicTracer&) = delete;
+
+        // Adds `amount` to a counter like ascopet::count and attributes it to this scope, so the counter's stats
+        // tell its throughput within the scope (e.g. bytes per second of decoding). Does nothing if this call
+        // isn't traced.
+        void count(SiteId counter, std::uint64_t amount) noexcept
+        {
+            if (m_buffer) {
+                m_buffer->add_record({
+                    .site   = counter,
+                    .flags  = std::uint8_t{ NamedRecord::counter } | NamedRecord::attached,
+                    .depth  = m_depth,
+                    .weight = 1,
+                    .start  = now(),
+                    .end    = amount,
+                });
+            }
+        }
 
     private:
-        std::size_t             m_capacity;
-        StrMap<RingBuf<Record>> m_records;
+        static constexpr std::uint8_t flags = T == Timing::serialized ? NamedRecord::serialized : 0;
+
+        LocalBuf*     m_buffer;
+        SiteId        m_site;
+        std::uint8_t  m_depth;
+        std::uint16_t m_weight;
+        std::uint64_t m_start;
+    };
+
+    using Tracer           = BasicTracer<Timing::fast>;
+    using SerializedTracer = BasicTracer<Timing::serialized>;
+
+    // detail of a compile-time named trace, checked against ASCOPET_LEVEL; a trace without one is `normal`
+    enum class Level
+    {
+        coarse = 1,
+        normal = 2,
+        fine   = 3,
     };
 
-    class [[nodiscard]] Tracer
+    constexpr bool compiled_in(Level level)
+    {
+        return static_cast<int>(level) <= ASCOPET_LEVEL;
+    }
+
+    // what a trace compiled out by ASCOPET_LEVEL returns, no state and no code
+    class [[nodiscard]] NullTracer
     {
     public:
-        ~Tracer();
-        Tracer(LocalBuf* buffer, std::string_view name);
+        // NOTE: user-provided so an unused tracer variable doesn't warn, which only happens with trivial types
+        NullTracer() noexcept {}
+        ~NullTracer() {}
 
-        Tracer(Tracer&&)            = delete;
-        Tracer& operator=(Tracer&&) = delete;
+        NullTracer(NullTracer&&)            = delete;
+        NullTracer& operator=(NullTracer&&) = delete;
 
-        Tracer(const Tracer&)            = delete;
-        Tracer& operator=(const Tracer&) = delete;
+        NullTracer(const NullTracer&)            = delete;
+        NullTracer& operator=(const NullTracer&) = delete;
 
+        void count(SiteId, std::uint64_t) noexcept {}
+    };
+
+    // opaque position of a consumer in the records of every thread, a new cursor starts from the oldest records
+    // still in the record windows
+    class ReportCursor
+    {
     private:
-        LocalBuf*        m_buffer;
-        std::string_view m_name;
-        std::uint64_t    m_start;
+        friend class Ascopet;
+
+        ThreadMap<TimingList::Cursor> m_threads;
+    };
+
+    // one path of a thread's call tree, see InitParam::call_tree
+    struct CallStat
+    {
+        std::vector<std::string_view> path;         // site names from the outermost scope to this one
+        std::size_t                   count;
+        StatDuration                  inclusive;    // total, nested scopes included
+        StatDuration                  self;         // total, excluding the time spent in traced nested scopes
     };
 
-    using Report    = ThreadMap<StrMap<TimingStat>>;
-    using RawReport = ThreadMap<StrMap<RingBuf<Record>>>;
+    using Report         = ThreadMap<StrMap<TimingStat>>;
+    using QuantileReport = ThreadMap<StrMap<QuantileStat>>;
+    using RawReport      = ThreadMap<StrMap<RingBuf<Record>>>;
+    using CallReport     = ThreadMap<std::vector<CallStat>>;
+    using CounterReport  = ThreadMap<StrMap<CounterStat>>;
+
+    // cumulative cost of the worker's drains since init
+    struct DrainStat
+    {
+        std::uint64_t polls;
+        std::uint64_t records;
+        Duration      busy;        // total time spent draining
+        Duration      max_busy;    // longest single drain
+        std::uint64_t wakeups;     // polls brought forward by a thread whose buffer filled up
+        Duration      interval;    // current poll interval
+    };
+
+    // cumulative since the thread's first trace: every produced record is either drained, overwritten,
+    // dropped, or still in the buffer
+    struct BufferStat
+    {
+        std::uint64_t produced;
+        std::uint64_t drained;
+        std::uint64_t overwritten;
+        std::uint64_t dropped;
+        std::size_t   capacity;
+    };
+
+    using BufferReport = ThreadMap<BufferStat>;
+    using ThreadReport = ThreadMap<ThreadInfo>;
+
+    // what becomes of the stats of an exited thread once InitParam::retire_ttl is over
+    enum class Retire
+    {
+        merge,     // merged into the aggregate of every retired thread, reported under std::thread::id{}
+        expire,    // dropped
+    };
+
+    // see Ascopet::start_recording
+    struct RecordParam
+    {
+        std::string path;
+        std::size_t max_file_size = 0;       // rotate to `path`.1, `path`.2, ... past this size, 0 never rotates
+        std::size_t block_records = 4096;    // the most records in a single block of the file
+    };
+
+    // see Ascopet::start_live
+    struct LiveParam
+    {
+        Duration    interval    = std::chrono::seconds{ 1 };    // between snapshots, at least 10 ms
+        std::size_t max_entries = 256;                          // the sites with the most total time
+    };
+
+    class LiveStats;
+    class Recorder;
+    class TaskPool;
+    class TraceExport;
 
     struct InitParam
     {
         bool        immediately_start = false;
-        Duration    poll_interval     = std::chrono::milliseconds{ 100 };
+        Duration    poll_interval     = std::chrono::milliseconds{ 100 };    // the longest, used when idle
+        Duration    min_poll_interval = std::chrono::milliseconds{ 1 };      // the shortest, used under load
         std::size_t record_capacity   = 1024;
         std::size_t buffer_capacity   = 1024;
+        double      wake_fill         = 0.75;     // fill ratio of a tls buffer that wakes the worker, 0 disables
+                                                  // the wakeup and 1 wakes it as the last free slot is taken
+        Overflow    overflow          = Overflow::overwrite;
+        bool        subtract_overhead = false;    // subtract the calibrated tracer overhead from durations
+        std::size_t drain_threads     = 1;        // threads draining the tls buffers when there are many of them, also
+                                                  // merging the aggregate report; all but one are kept in a pool
+
+        // spans of the rolling time windows kept for every entry (e.g. 1s, 10s, 60s), none by default; each one
+        // is split into `window_buckets` tumbling buckets, which is also the granularity of its oldest edge
+        std::vector<Duration> windows        = {};
+        std::size_t           window_buckets = 10;
+
+        // build a call tree of every thread's nested scopes with the inclusive and self time of each path, at a
+        // small cost for the worker
+        bool call_tree = false;
+
+        // An exited thread's buffer is handed to the worker, which drains what is left in it, and its stats are
+        // kept on their own for `retire_ttl` (forever by default), then retired. A new thread reusing the id of an
+        // exited one retires it at once, so the stats of two threads are never mixed under the same id.
+        Retire   retire     = Retire::merge;
+        Duration retire_ttl = Duration::max();
     };
 
     class Ascopet
@@ -90,11 +430,65 @@ namespace ascopet
 
         ~Ascopet();
 
-        Report report() const;
-        Report report_consume(bool remove_entries);
+        Report report(bool exact = false) const;
+        Report report_consume(bool remove_entries, bool exact = false);
+
+        // arbitrary quantiles (in [0, 1]) estimated from each entry's histogram
+        QuantileReport report_quantiles(std::span<const double> quantiles) const;
+
+        // entries of every thread merged by name: pooled mean/stdev, global min/max, and quantiles from the
+        // merged histograms; the interval is still the time between calls within the same thread
+        StrMap<TimingStat> aggregate_report() const;
 
         RawReport raw_report() const;
 
+        // only the entries with records since the cursor's last call, with stats over just those records;
+        // each consumer keeps its own cursor so none of them disturbs the others
+        Report report_since(ReportCursor& cursor) const;
+
+        // every path of each thread's call tree, parents first; empty unless InitParam::call_tree is set
+        CallReport call_report() const;
+
+        // the counters, gauges and instant events of each thread since the last clear
+        CounterReport report_counters() const;
+
+        // the call trees of every thread merged into folded stacks, one `outer;inner;leaf <self ns>` line per
+        // path, as read by flamegraph.pl and speedscope
+        std::string folded_stacks() const;
+
+        // stats over the records that started within the last `window`, which must be one of the windows given
+        // on init (otherwise the report is empty); the records of the current poll interval aren't in it yet
+        Report report_window(Duration window) const;
+
+        // Streams every record drained from now on to `fd` as a Chrome trace event, loadable by chrome://tracing
+        // and ui.perfetto.dev, until stop_export(). The events are written by the worker as it drains, one
+        // track per thread; starting a new export closes the previous one. The descriptor is never closed.
+        void start_export(int fd);
+        void stop_export();
+
+        // Appends every record drained from now on to a memory-mapped binary file until stop_recording(), so the
+        // whole history is kept at disk cost only; see recording.hpp for the layout and the ascopet-read tool to
+        // read it back. The worker writes the records as it drains them, the traced threads do nothing more.
+        // Starting a new recording stops the previous one. False if the file can't be created, which is always the
+        // case on Windows.
+        bool start_recording(RecordParam param);
+        void stop_recording();
+
+        // Publishes a snapshot of aggregate_report() every `interval` into the POSIX shared-memory segment
+        // `/ascopet.<pid>` until stop_live(), for ascopet-top or any other process to read; see live.hpp for the
+        // layout. The worker computes and writes the snapshots, the traced threads do nothing more, and like the
+        // worker they pause with tracing. False if the segment can't be created, which is always the case on
+        // Windows.
+        bool start_live(LiveParam param = {});
+        void stop_live();
+
+        // loss accounting of the tls buffer of every live thread
+        BufferReport buffer_report() const;
+
+        // OS id and name of every thread in the reports, exited ones included; an exited thread stays alive until
+        // the worker has drained what it left in its buffer
+        ThreadReport thread_report() const;
+
         void clear(bool remove_entries = false);
 
         bool is_tracing() const;
@@ -106,41 +500,501 @@ namespace ascopet
 
         void resize_record_capacity(std::size_t capacity);
 
+        // the longest poll interval, the worker polls more often while the buffers fill up quickly
         Duration process_interval() const;
         void     set_process_interval(Duration interval);
 
         std::uint64_t tsc_freq() const;
 
+        DrainStat drain_stat() const;
+
+        // fixed cost of a tracer start/end pair as measured on an empty scope, calibrated on init
+        Duration      overhead(Timing timing = Timing::fast) const;
+        std::uint64_t overhead_ticks(Timing timing = Timing::fast) const;
+
     private:
         Ascopet(InitParam&& param);
 
-        void add_localbuf(std::thread::id id, LocalBuf& buffer);
-        void remove_localbuf(std::thread::id id);
+        // NOTE: Each TimingList has its own lock so reporting a thread's entries only has to wait for the
+        // drain of that same thread, and m_data_mutex only guards the structure of the map.
+        struct Shard
+        {
+            Shard(std::size_t capacity, std::vector<std::uint64_t> windows, std::size_t window_buckets, bool call_tree)
+                : list{ capacity, std::move(windows), window_buckets, call_tree }
+            {
+            }
+
+            mutable std::mutex                                   mutex;
+            TimingList                                           list;
+            ThreadInfo                                           info;
+            std::optional<std::chrono::steady_clock::time_point> retired;    // when its thread exited
+        };
+
+        // A thread's buffer is owned by its slot and drained while holding the slot's lock. When the thread
+        // exits, the slot moves to the exited ones for the worker to drain and retire, so the thread itself only
+        // takes the registry lock briefly.
+        struct BufferSlot
+        {
+            BufferSlot(std::thread::id new_id, std::unique_ptr<LocalBuf> new_buffer, ThreadInfo new_info)
+                : id{ new_id }
+                , buffer{ std::move(new_buffer) }
+                , info{ std::move(new_info) }
+            {
+            }
+
+            std::mutex                mutex;
+            std::thread::id           id;
+            std::unique_ptr<LocalBuf> buffer;    // null once its thread is gone and it was drained
+            ThreadInfo                info;
+        };
+
+        using RetireClock = std::chrono::steady_clock;
+
+        LocalBuf* add_localbuf(std::thread::id id);
+        void      remove_localbuf(std::thread::id id);
+
+        // drains and retires the slots of the exited threads, only the ones of `id` if given
+        void settle_exited(std::optional<std::thread::id> id);
+
+        // marks the list of an exited thread as retired, then merges or drops it once its ttl is over; a list
+        // retired at another time than `when` (its id was reused since) is left alone
+        void retire(std::thread::id id, ThreadInfo info);
+        void retire_now(std::thread::id id, std::optional<RetireClock::time_point> when);
+        void retire_expired();
+
+        std::unique_ptr<Shard> make_shard(ThreadInfo info) const;
 
-        void worker(std::stop_token st);
+        std::size_t drain(BufferSlot& slot);
+        void        worker(std::stop_token st);
+        void        wake_worker();
 
         static std::unique_ptr<Ascopet> s_instance;
 
         mutable std::shared_mutex m_data_mutex;
+        mutable std::mutex        m_buffers_mutex;
         mutable std::mutex        m_cond_mutex;
         std::condition_variable   m_cv;
 
-        ThreadMap<TimingList> m_records;
+        ThreadMap<std::unique_ptr<Shard>> m_records;
 
-        std::atomic<bool>    m_processing;
-        std::jthread         m_worker;
-        ThreadMap<LocalBuf*> m_buffers;
+        std::atomic<bool>                      m_processing;
+        ThreadMap<std::shared_ptr<BufferSlot>> m_buffers;
 
-        std::size_t m_record_capacity;
-        std::size_t m_buffer_capacity;
+        // slots of the exited threads with their last info, guarded by m_buffers_mutex; m_settle_mutex is held
+        // while they are drained, so a new thread with the id of one waits for it to be out of the way
+        std::vector<std::pair<std::shared_ptr<BufferSlot>, ThreadInfo>> m_exited;
+        std::mutex                                                      m_settle_mutex;
 
-        Duration      m_process_interval;
-        std::uint64_t m_tsc_freq;
+        std::size_t       m_record_capacity;
+        const std::size_t m_buffer_capacity;
+        const std::size_t m_drain_threads;
+        const std::size_t m_wake_watermark;
+        const Overflow    m_overflow;
+
+        std::atomic<Duration> m_process_interval;
+        const Duration        m_min_process_interval;
+        std::atomic<bool>     m_wake = false;
+        std::uint64_t         m_tsc_freq;
+
+        const std::vector<Duration>      m_windows;
+        const std::vector<std::uint64_t> m_window_ticks;    // the same spans in ticks
+        const std::size_t                m_window_buckets;
+        const bool                       m_call_tree;
+
+        const Retire   m_retire;
+        const Duration m_retire_ttl;
+
+        // exited threads waiting for their ttl, oldest first; guarded by m_buffers_mutex
+        std::deque<std::pair<RetireClock::time_point, std::thread::id>> m_retiring;
+
+        std::uint64_t m_overhead;
+        std::uint64_t m_serialized_overhead;
+        bool          m_subtract_overhead;
+
+        std::unique_ptr<TraceExport> m_export;
+        std::unique_ptr<Recorder>    m_recorder;
+        std::unique_ptr<LiveStats>   m_live;
+
+        // the drain_threads - 1 helpers of the worker and of aggregate_report()
+        std::unique_ptr<TaskPool> m_pool;
+
+        std::atomic<std::uint64_t> m_drain_polls   = 0;
+        std::atomic<std::uint64_t> m_drain_records = 0;
+        std::atomic<Duration::rep> m_drain_busy    = 0;
+        std::atomic<Duration::rep> m_drain_max     = 0;
+        std::atomic<std::uint64_t> m_drain_wakeups = 0;
+        std::atomic<Duration::rep> m_drain_current = 0;
+
+        // NOTE: started last so the worker never sees a partially constructed instance
+        std::jthread m_worker;
     };
 
     Ascopet* instance();
     Ascopet* init(InitParam&& param = {});
 
-    Tracer trace(std::source_location location = std::source_location::current());
-    Tracer trace(std::string_view name);
+    namespace detail
+    {
+        // mirrors Ascopet::is_tracing() so the hot path doesn't have to go through instance()
+        inline std::atomic<bool> s_enabled = false;
+
+        // this thread's buffer, null until the first trace while tracing
+        inline constinit thread_local LocalBuf* s_localbuf = nullptr;
+
+        // last runtime name looked up by this thread, names are traced in loops more often than not
+        struct NameCache
+        {
+            const char* str;
+            std::size_t len;
+            SiteId      site;
+        };
+
+        inline constinit thread_local NameCache s_name_cache = { nullptr, 0, 0 };
+
+        // slow paths, kept out of line
+        LocalBuf* acquire_localbuf();
+        SiteId    lookup_site(std::string_view name);
+        SiteId    lookup_site(std::source_location location);
+
+        inline SiteId cached_site(std::string_view name)
+        {
+            if (name.data() == s_name_cache.str and name.size() == s_name_cache.len) {
+                return s_name_cache.site;
+            }
+            return lookup_site(name);
+        }
+
+        // pushes a record of something else than a scope, stamped now; never sampled, only checked for enabling
+        inline void push_event(SiteId site, NamedRecord::Kind kind, std::uint64_t value)
+        {
+            if (not s_enabled.load(std::memory_order::relaxed)) {
+                return;
+            }
+
+            auto buffer = s_localbuf;
+            if (buffer == nullptr) [[unlikely]] {
+                buffer = acquire_localbuf();
+                if (buffer == nullptr) {
+                    return;
+                }
+            }
+            if (auto epoch = s_site_epoch.load(std::memory_order::relaxed); epoch != 0) [[unlikely]] {
+                if (not buffer->is_enabled(site, epoch)) {
+                    return;
+                }
+            }
+
+            buffer->add_record({
+                .site   = site,
+                .flags  = kind,
+                .depth  = buffer->depth(),
+                .weight = 1,
+                .start  = now(),
+                .end    = value,
+            });
+        }
+    }
+
+    namespace detail
+    {
+        // the buffer to record a call of the site in, null if the call isn't traced: tracing is paused, there is
+        // no instance, the thread is exiting, or the call is skipped by the sampling of the site
+        inline LocalBuf* sampled_localbuf(SiteId site, std::uint16_t& weight)
+        {
+            if (not s_enabled.load(std::memory_order::relaxed)) {
+                return nullptr;
+            }
+
+            auto buffer = s_localbuf;
+            if (buffer == nullptr) [[unlikely]] {
+                buffer = acquire_localbuf();
+                if (buffer == nullptr) {
+                    return nullptr;
+                }
+            }
+
+            if (auto epoch = s_site_epoch.load(std::memory_order::relaxed); epoch != 0) [[unlikely]] {
+                if (not buffer->sample(site, epoch, weight)) {
+                    return nullptr;
+                }
+            }
+            return buffer;
+        }
+    }
+
+    template <Timing T = Timing::fast>
+    inline BasicTracer<T> trace(SiteId site)
+    {
+        // NOTE: a skipped call doesn't enter the shadow stack either, its nested scopes are attributed to the
+        // closest enclosing scope that was sampled
+        auto weight = std::uint16_t{ 1 };
+        if (auto buffer = detail::sampled_localbuf(site, weight); buffer != nullptr) {
+            return { buffer, site, weight };
+        }
+        return { nullptr, site };
+    }
+
+    inline Tracer trace(std::source_location location = std::source_location::current())
+    {
+        if (detail::s_enabled.load(std::memory_order::relaxed)) {
+            return trace(detail::lookup_site(location));
+        }
+        return { nullptr, 0 };
+    }
+
+    inline Tracer trace(std::string_view name)
+    {
+        if (detail::s_enabled.load(std::memory_order::relaxed)) {
+            return trace(detail::cached_site(name));
+        }
+        return { nullptr, 0 };
+    }
+
+    // the site is registered once on first call, no name lookup is done afterwards; a level above
+    // ASCOPET_LEVEL returns a NullTracer and neither registers the site nor reads any state
+    template <FixedString Name, Level L, Timing T = Timing::fast>
+    auto trace(std::source_location location = std::source_location::current())
+    {
+        if constexpr (compiled_in(L)) {
+            static const auto site = register_site(Name, location);
+            return trace<T>(site);
+        } else {
+            return NullTracer{};
+        }
+    }
+
+    template <FixedString Name, Timing T = Timing::fast>
+    auto trace(std::source_location location = std::source_location::current())
+    {
+        return trace<Name, Level::normal, T>(location);
+    }
+
+    // A traced scope that isn't bound to a C++ scope nor to a thread, for asynchronous code: it can be moved
+    // into a callback or a coroutine frame and is recorded in the buffer of whichever thread ends it, or
+    // destroys it. Its stamps are taken with Timing::fast, which must be comparable across cores (an invariant
+    // TSC, or the steady clock fallback). A span stays out of the call tree, since it doesn't enter the shadow
+    // stack of any thread.
+    //
+    // With an on-CPU site, the time between suspend() and resume() is left out of a second record of that site:
+    // it starts with the span and lasts as long as the span was running. It is only recorded if the span was
+    // ever suspended, so its count tells how many spans were.
+    class [[nodiscard]] Span
+    {
+    public:
+        // gives the on-CPU site when it is first needed, so spans that never suspend don't register it
+        using LazySite = SiteId (*)();
+
+        Span() noexcept = default;
+
+        ~Span() { end(); }
+
+        // begins now whether tracing or not, see ascopet::span
+        Span(SiteId site, std::optional<SiteId> cpu_site, std::uint16_t weight = 1) noexcept
+            : m_site{ site }
+            , m_cpu_site{ cpu_site }
+            , m_weight{ weight }
+            , m_active{ true }
+            , m_start{ now() }
+            , m_resumed{ m_start }
+        {
+        }
+
+        Span(SiteId site, LazySite cpu_site, std::uint16_t weight = 1) noexcept
+            : Span{ site, std::nullopt, weight }
+        {
+            m_lazy_cpu_site = cpu_site;
+        }
+
+        Span(Span&& other) noexcept { swap(other); }
+
+        Span& operator=(Span&& other) noexcept
+        {
+            if (this != &other) {
+                end();
+                swap(other);
+            }
+            return *this;
+        }
+
+        Span(const Span&)            = delete;
+        Span& operator=(const Span&) = delete;
+
+        // records the span in the calling thread's buffer; does nothing if it already ended, isn't traced, or
+        // tracing was paused or its site disabled since it began
+        void end()
+        {
+            if (not m_active) {
+                return;
+            }
+
+            m_active   = false;
+            auto stamp = now();
+            if (not detail::s_enabled.load(std::memory_order::relaxed)) {
+                return;
+            }
+
+            auto buffer = detail::s_localbuf ? detail::s_localbuf : detail::acquire_localbuf();
+            if (buffer == nullptr) {
+                return;
+            }
+
+            auto epoch   = detail::s_site_epoch.load(std::memory_order::relaxed);
+            auto enabled = [&](SiteId site) { return epoch == 0 or buffer->is_enabled(site, epoch); };
+            if (not enabled(m_site)) {
+                return;
+            }
+
+            auto record = NamedRecord{
+                .site   = m_site,
+                .flags  = NamedRecord::detached,
+                .depth  = buffer->depth(),
+                .weight = m_weight,
+                .start  = m_start,
+                .end    = stamp,
+            };
+            buffer->add_record(record);
+
+            if (m_suspended_once and not m_cpu_site and m_lazy_cpu_site) {
+                m_cpu_site = m_lazy_cpu_site();
+            }
+            if (m_suspended_once and m_cpu_site and enabled(*m_cpu_site)) {
+                record.site = *m_cpu_site;
+                record.end  = m_start + m_running + (m_suspended ? 0 : stamp - m_resumed);
+                buffer->add_record(record);
+            }
+        }
+
+        void suspend() noexcept
+        {
+            if (m_active and not m_suspended) {
+                m_running       += now() - m_resumed;
+                m_suspended      = true;
+                m_suspended_once = true;
+            }
+        }
+
+        void resume() noexcept
+        {
+            if (m_active and m_suspended) {
+                m_resumed   = now();
+                m_suspended = false;
+            }
+        }
+
+        // false once ended, and for a call that isn't traced
+        bool active() const noexcept { return m_active; }
+
+    private:
+        void swap(Span& other) noexcept
+        {
+            std::swap(m_site, other.m_site);
+            std::swap(m_cpu_site, other.m_cpu_site);
+            std::swap(m_lazy_cpu_site, other.m_lazy_cpu_site);
+            std::swap(m_weight, other.m_weight);
+            std::swap(m_active, other.m_active);
+            std::swap(m_suspended, other.m_suspended);
+            std::swap(m_suspended_once, other.m_suspended_once);
+            std::swap(m_start, other.m_start);
+            std::swap(m_resumed, other.m_resumed);
+            std::swap(m_running, other.m_running);
+        }
+
+        SiteId                m_site          = 0;
+        std::optional<SiteId> m_cpu_site      = std::nullopt;
+        LazySite              m_lazy_cpu_site = nullptr;
+
+        std::uint16_t m_weight         = 1;
+        bool          m_active         = false;
+        bool          m_suspended      = false;
+        bool          m_suspended_once = false;
+        std::uint64_t m_start          = 0;
+        std::uint64_t m_resumed        = 0;    // stamp of the last resume, or the start
+        std::uint64_t m_running        = 0;    // ticks spent running before the last suspend
+    };
+
+    namespace detail
+    {
+        // the cpu site is either a SiteId or a Span::LazySite
+        template <typename CpuSite>
+        Span begin_span(SiteId site, CpuSite cpu_site)
+        {
+            auto weight = std::uint16_t{ 1 };
+            if (sampled_localbuf(site, weight) != nullptr) {
+                return { site, cpu_site, weight };
+            }
+            return {};
+        }
+
+        // the on-CPU site of span<Name>(), named after it with a "/cpu" suffix
+        template <FixedString Name>
+        SiteId cpu_site()
+        {
+            static const auto site = intern(std::string{ std::string_view{ Name } } + "/cpu");
+            return site;
+        }
+    }
+
+    // begins a span on the calling thread, sampled and enabled like trace(SiteId)
+    inline Span span(SiteId site, std::optional<SiteId> cpu_site = std::nullopt)
+    {
+        return detail::begin_span(site, cpu_site);
+    }
+
+    // registers the site once on first call, and the on-CPU one once the first suspended span ends
+    template <FixedString Name>
+    Span span(std::source_location location = std::source_location::current())
+    {
+        static const auto site = register_site(Name, location);
+        return detail::begin_span(site, Span::LazySite{ &detail::cpu_site<Name> });
+    }
+
+    // Counters, gauges and instant events go through the same thread buffers as the scopes and are reported by
+    // Ascopet::report_counters: a counter adds up its increments, a gauge keeps the samples of a value and an
+    // instant event only marks a point in time. A site should be used for only one of them.
+    inline void count(SiteId counter, std::uint64_t amount = 1)
+    {
+        detail::push_event(counter, NamedRecord::counter, amount);
+    }
+
+    inline void gauge(SiteId gauge, std::uint64_t value)
+    {
+        detail::push_event(gauge, NamedRecord::gauge, value);
+    }
+
+    inline void mark(SiteId event)
+    {
+        detail::push_event(event, NamedRecord::instant, 0);
+    }
+
+    // the site is registered once on first call, like trace<Name>()
+    template <FixedString Name>
+    void count(std::uint64_t amount = 1, std::source_location location = std::source_location::current())
+    {
+        static const auto site = register_site(Name, location);
+        count(site, amount);
+    }
+
+    template <FixedString Name>
+    void gauge(std::uint64_t value, std::source_location location = std::source_location::current())
+    {
+        static const auto site = register_site(Name, location);
+        gauge(site, value);
+    }
+
+    template <FixedString Name>
+    void mark(std::source_location location = std::source_location::current())
+    {
+        static const auto site = register_site(Name, location);
+        mark(site);
+    }
 }
+
+#define ASCOPET_CONCAT_IMPL(a, b) a##b
+#define ASCOPET_CONCAT(a, b)      ASCOPET_CONCAT_IMPL(a, b)
+
+#define ASCOPET_TRACE(name) auto ASCOPET_CONCAT(ascopet_tracer_, __COUNTER__) = ::ascopet::trace<name>()
+#define ASCOPET_TRACE_SERIALIZED(name)                                                                       \
+    auto ASCOPET_CONCAT(ascopet_tracer_, __COUNTER__) = ::ascopet::trace<name, ::ascopet::Timing::serialized>()
+
+// `level` is one of coarse, normal or fine: ASCOPET_TRACE_LEVEL(fine, "name")
+#define ASCOPET_TRACE_LEVEL(level, name)                                                                     \
+    auto ASCOPET_CONCAT(ascopet_tracer_, __COUNTER__) = ::ascopet::trace<name, ::ascopet::Level::level>()
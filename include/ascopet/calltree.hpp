@@ -0,0 +1,109 @@
+#pragma once
+
+#include "ascopet/site.hpp"
+
+#include <algorithm>
+#include <concepts>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace ascopet
+{
+    // Call tree of a thread's scopes rebuilt from the depth of its records, with the inclusive and self ticks of
+    // every path. A thread's records arrive in the order their scopes ended, so the scopes nested in a record
+    // are exactly the records one level deeper that arrived since the last record of its own depth. Completed
+    // scopes wait at their depth until their parent arrives and are merged by site on the way, so the memory
+    // is bounded by the number of distinct paths rather than the number of calls; a path only shows up once
+    // its outermost scope ends.
+    class CallTree
+    {
+    public:
+        struct Node
+        {
+            SiteId            site;
+            std::uint64_t     count     = 0;
+            std::uint64_t     inclusive = 0;    // ticks, children included
+            std::uint64_t     self      = 0;    // ticks not spent in any traced child
+            std::vector<Node> children;
+        };
+
+        void add(SiteId site, std::uint8_t depth, std::uint64_t duration)
+        {
+            if (m_pending.size() < depth + 2u) {
+                m_pending.resize(depth + 2u);
+            }
+
+            auto node = Node{ .site = site, .count = 1, .inclusive = duration, .self = duration, .children = {} };
+            node.children.swap(m_pending[depth + 1u]);
+            for (const auto& child : node.children) {
+                node.self -= std::min(node.self, child.inclusive);
+            }
+
+            // deeper scopes still waiting lost their parent to a dropped or overwritten record
+            for (auto i = depth + 2u; i < m_pending.size(); ++i) {
+                m_pending[i].clear();
+            }
+
+            merge(depth == 0 ? m_roots : m_pending[depth], std::move(node));
+        }
+
+        void clear()
+        {
+            m_roots.clear();
+            m_pending.clear();
+        }
+
+        // merges the completed paths of another tree into this one, its scopes still waiting for a parent are lost
+        void absorb(const CallTree& other)
+        {
+            for (const auto& root : other.m_roots) {
+                merge(m_roots, Node{ root });
+            }
+        }
+
+        const std::vector<Node>& roots() const { return m_roots; }
+
+        // calls fn(path, node) for every node, parents first; `path` holds the sites from the root to the node
+        template <std::invocable<std::span<const SiteId>, const Node&> Fn>
+        void for_each_path(Fn&& fn) const
+        {
+            auto path = std::vector<SiteId>{};
+            for (const auto& root : m_roots) {
+                visit(root, path, fn);
+            }
+        }
+
+        static void merge(std::vector<Node>& siblings, Node&& node)
+        {
+            auto it = std::find_if(siblings.begin(), siblings.end(), [&](const Node& n) { return n.site == node.site; });
+            if (it == siblings.end()) {
+                siblings.push_back(std::move(node));
+                return;
+            }
+
+            it->count     += node.count;
+            it->inclusive += node.inclusive;
+            it->self      += node.self;
+            for (auto& child : node.children) {
+                merge(it->children, std::move(child));
+            }
+        }
+
+    private:
+        template <typename Fn>
+        static void visit(const Node& node, std::vector<SiteId>& path, Fn& fn)
+        {
+            path.push_back(node.site);
+            fn(std::span<const SiteId>{ path }, node);
+            for (const auto& child : node.children) {
+                visit(child, path, fn);
+            }
+            path.pop_back();
+        }
+
+        std::vector<Node>              m_roots;
+        std::vector<std::vector<Node>> m_pending;    // completed scopes waiting for their parent, by depth
+    };
+}
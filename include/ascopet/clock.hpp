@@ -0,0 +1,65 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+#if not defined(ASCOPET_DISABLE_RDTSC)
+#    if defined(_MSC_VER)
+#        include <intrin.h>
+#    else
+#        include <x86intrin.h>
+#    endif
+#endif
+
+namespace ascopet
+{
+    // Timing::serialized fences the timestamp reads so out-of-order execution can't move work across them,
+    // at the cost of a few extra ns per read; use it for very short scopes where that skew matters
+    enum class Timing
+    {
+        fast,
+        serialized,
+    };
+
+    // timestamp used for every record, in ticks of Ascopet::tsc_freq()
+    inline std::uint64_t now() noexcept
+    {
+#if not defined(ASCOPET_DISABLE_RDTSC)
+        return __rdtsc();
+#else
+        return static_cast<std::uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+    }
+
+    // timestamp taken at the start of a scope: earlier instructions must retire before it is read and later
+    // instructions must not start before it
+    template <Timing T = Timing::fast>
+    inline std::uint64_t start_stamp() noexcept
+    {
+#if not defined(ASCOPET_DISABLE_RDTSC)
+        if constexpr (T == Timing::serialized) {
+            _mm_lfence();
+            auto stamp = __rdtsc();
+            _mm_lfence();
+            return stamp;
+        }
+#endif
+        return now();
+    }
+
+    // timestamp taken at the end of a scope: rdtscp waits for the scope's instructions to retire and the
+    // fence keeps later instructions from starting before the read
+    template <Timing T = Timing::fast>
+    inline std::uint64_t end_stamp() noexcept
+    {
+#if not defined(ASCOPET_DISABLE_RDTSC)
+        if constexpr (T == Timing::serialized) {
+            auto aux   = 0u;
+            auto stamp = __rdtscp(&aux);
+            _mm_lfence();
+            return stamp;
+        }
+#endif
+        return now();
+    }
+}
@@ -1,5 +1,8 @@
 #pragma once
 
+#include "ascopet/site.hpp"
+
+#include <string>
 #include <thread>
 #include <unordered_map>
 
@@ -13,11 +16,36 @@ namespace ascopet
 
     struct NamedRecord
     {
-        std::string_view name;
-        std::uint64_t    start;
-        std::uint64_t    end;
+        enum Flags : std::uint8_t
+        {
+            serialized = 1 << 0,    // stamps were taken with Timing::serialized
+            attached   = 1 << 3,    // a counter increment that also counts towards its enclosing scope
+            detached   = 1 << 4,    // a Span, outside the shadow stack of the thread that recorded it
+        };
+
+        // what the record measures, kept in bits 1-2 of the flags; anything but a scope is stamped once, at
+        // `start`, and keeps its value in `end`
+        enum Kind : std::uint8_t
+        {
+            scope     = 0 << 1,
+            counter   = 1 << 1,    // `end` is an increment
+            gauge     = 2 << 1,    // `end` is a sample
+            instant   = 3 << 1,    // no value
+            kind_mask = 3 << 1,
+        };
+
+        Kind kind() const { return static_cast<Kind>(flags & kind_mask); }
+
+        SiteId        site;
+        std::uint8_t  flags = 0;
+        std::uint8_t  depth  = 0;    // number of enclosing scopes traced by the same thread, saturated
+        std::uint16_t weight = 1;    // calls this record stands for, more than 1 for a sampled site (see Sampling)
+        std::uint64_t start;
+        std::uint64_t end;
     };
 
+    static_assert(sizeof(NamedRecord) == 24);
+
     struct StrHash
     {
         using is_transparent = void;
@@ -33,4 +61,12 @@ namespace ascopet
 
     template <typename T>
     using ThreadMap = std::unordered_map<std::thread::id, T>;
+
+    // what the OS knows a traced thread as, a std::thread::id is opaque and reused by later threads
+    struct ThreadInfo
+    {
+        std::uint64_t tid = 0;    // gettid() on Linux, 0 for the retired threads' aggregate
+        std::string   name;       // as set with pthread_setname_np, taken on the first trace and again on exit
+        bool          alive = true;
+    };
 }
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "ascopet/ascopet.hpp"
+
+#include <coroutine>
+#include <type_traits>
+#include <utility>
+
+namespace ascopet
+{
+    namespace detail
+    {
+        // what `co_await awaitable` would await, without the promise's await_transform
+        template <typename Awaitable>
+        decltype(auto) get_awaiter(Awaitable&& awaitable)
+        {
+            if constexpr (requires { std::forward<Awaitable>(awaitable).operator co_await(); }) {
+                return std::forward<Awaitable>(awaitable).operator co_await();
+            } else if constexpr (requires { operator co_await(std::forward<Awaitable>(awaitable)); }) {
+                return operator co_await(std::forward<Awaitable>(awaitable));
+            } else {
+                return std::forward<Awaitable>(awaitable);
+            }
+        }
+
+        // an lvalue awaiter is awaited in place, a temporary one is moved into the wrapper
+        template <typename Awaitable>
+        using AwaiterOf = std::conditional_t<
+            std::is_lvalue_reference_v<decltype(get_awaiter(std::declval<Awaitable>()))>,
+            decltype(get_awaiter(std::declval<Awaitable>())),
+            std::remove_cvref_t<decltype(get_awaiter(std::declval<Awaitable>()))>>;
+    }
+
+    // Awaits another awaiter with the span suspended, so the time the coroutine spends waiting is left out of the
+    // span's on-CPU time. The span is suspended before the coroutine is handed over, which may resume it on
+    // another thread before await_suspend even returns, and resumed by whichever thread resumes the coroutine.
+    template <typename Awaiter>
+    class SpanAwaiter
+    {
+    public:
+        SpanAwaiter(Span& span, Awaiter&& awaiter)
+            : m_span{ span }
+            , m_awaiter{ std::forward<Awaiter>(awaiter) }
+        {
+        }
+
+        bool await_ready() { return m_awaiter.await_ready(); }
+
+        template <typename Promise>
+        decltype(auto) await_suspend(std::coroutine_handle<Promise> handle)
+        {
+            m_span.suspend();
+            return m_awaiter.await_suspend(handle);
+        }
+
+        decltype(auto) await_resume()
+        {
+            m_span.resume();
+            return m_awaiter.await_resume();
+        }
+
+    private:
+        Span&   m_span;
+        Awaiter m_awaiter;
+    };
+
+    // `co_await traced(span, socket.read(buffer))`; a promise can route every co_await of its coroutines
+    // through it with an await_transform that returns traced(its_span, awaitable)
+    template <typename Awaitable>
+    SpanAwaiter<detail::AwaiterOf<Awaitable>> traced(Span& span, Awaitable&& awaitable)
+    {
+        return { span, detail::get_awaiter(std::forward<Awaitable>(awaitable)) };
+    }
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace ascopet
+{
+    // Log-linear histogram of tick values (HDR histogram style). Values below 2^sub_bits are counted exactly,
+    // every power-of-two range above that is split into 2^sub_bits equal buckets, so any quantile is off by
+    // at most `relative_error`. Only the range of buckets between the smallest and the largest value seen is
+    // stored, which is bounded by (65 - sub_bits) * 2^sub_bits buckets but usually only a few hundred.
+    class Histogram
+    {
+    public:
+        static constexpr std::uint32_t sub_bits       = 5;
+        static constexpr double        relative_error = 1.0 / (2u << sub_bits);
+        static constexpr std::uint32_t max_buckets    = (65 - sub_bits) << sub_bits;
+
+        void add(std::uint64_t value, std::uint64_t count = 1)
+        {
+            if (count == 0) {
+                return;
+            }
+
+            auto idx = index(value);
+            reserve(idx, idx);
+            m_buckets[idx - m_offset] += count;
+
+            m_count += count;
+            m_min    = std::min(m_min, value);
+            m_max    = std::max(m_max, value);
+        }
+
+        // merging is exact: the result is the same as if every value were added to one histogram
+        void merge(const Histogram& other)
+        {
+            if (other.m_count == 0) {
+                return;
+            }
+
+            auto last = other.m_offset + static_cast<std::uint32_t>(other.m_buckets.size()) - 1;
+            reserve(other.m_offset, last);
+            for (auto i = 0u; i < other.m_buckets.size(); ++i) {
+                m_buckets[other.m_offset + i - m_offset] += other.m_buckets[i];
+            }
+
+            m_count += other.m_count;
+            m_min    = std::min(m_min, other.m_min);
+            m_max    = std::max(m_max, other.m_max);
+        }
+
+        void reset() { *this = {}; }
+
+        // nearest-rank quantile, q in [0, 1]; returns 0 if empty
+        std::uint64_t quantile(double q) const
+        {
+            if (m_count == 0) {
+                return 0;
+            }
+
+            auto rank = static_cast<std::uint64_t>(std::ceil(std::clamp(q, 0.0, 1.0) * static_cast<double>(m_count)));
+            rank      = std::max(rank, std::uint64_t{ 1 });
+
+            // the extremes are known exactly
+            if (rank == 1) {
+                return m_min;
+            } else if (rank == m_count) {
+                return m_max;
+            }
+
+            auto cumulative = std::uint64_t{ 0 };
+            for (auto i = 0u; i < m_buckets.size(); ++i) {
+                cumulative += m_buckets[i];
+                if (cumulative >= rank) {
+                    return std::clamp(midpoint(m_offset + i), m_min, m_max);
+                }
+            }
+
+            return m_max;
+        }
+
+        std::uint64_t count() const { return m_count; }
+        std::uint64_t min() const { return m_count ? m_min : 0; }
+        std::uint64_t max() const { return m_max; }
+
+    private:
+        static constexpr std::uint64_t sub_count = 1ull << sub_bits;
+
+        static std::uint32_t index(std::uint64_t value)
+        {
+            if (value < sub_count) {
+                return static_cast<std::uint32_t>(value);
+            }
+            auto shift = static_cast<std::uint32_t>(std::bit_width(value)) - 1 - sub_bits;
+            auto sub   = static_cast<std::uint32_t>((value >> shift) & (sub_count - 1));
+            return ((shift + 1) << sub_bits) + sub;
+        }
+
+        static std::uint64_t midpoint(std::uint32_t index)
+        {
+            if (index < sub_count) {
+                return index;
+            }
+            auto shift = (index >> sub_bits) - 1;
+            auto lower = ((sub_count | (index & (sub_count - 1))) << shift);
+            return lower + ((1ull << shift) >> 1);
+        }
+
+        // grow the stored range so it covers [first, last]
+        void reserve(std::uint32_t first, std::uint32_t last)
+        {
+            assert(last < max_buckets);
+
+            if (m_buckets.empty()) {
+                m_offset = first;
+                m_buckets.resize(last - first + 1);
+                return;
+            }
+
+            if (first < m_offset) {
+                m_buckets.insert(m_buckets.begin(), m_offset - first, 0);
+                m_offset = first;
+            }
+            if (auto size = last - m_offset + 1; size > m_buckets.size()) {
+                m_buckets.resize(size);
+            }
+        }
+
+        std::vector<std::uint64_t> m_buckets;
+        std::uint32_t              m_offset = 0;
+
+        std::uint64_t m_count = 0;
+        std::uint64_t m_min   = std::numeric_limits<std::uint64_t>::max();
+        std::uint64_t m_max   = 0;
+    };
+}
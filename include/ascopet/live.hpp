@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Layout of the shared-memory segment published by Ascopet::start_live, in the byte order of the machine.
+//
+// The segment is a Header followed by `capacity` Entries, of which the first `count` hold the last snapshot,
+// sorted by total time. The worker rewrites the whole snapshot under a seqlock: `sequence` is odd while it
+// writes, so a reader copies what it needs between two loads of an even and unchanged sequence, and retries
+// otherwise. Readers never write to the segment and the worker never waits for them.
+namespace ascopet::live
+{
+    inline constexpr char          magic[8]    = { 'A', 'S', 'C', 'L', 'I', 'V', 'E', '\0' };
+    inline constexpr std::uint32_t version     = 1;
+    inline constexpr std::size_t   name_length = 64;    // names are truncated to fit, always null-terminated
+
+    struct Header
+    {
+        char                       magic[8];
+        std::uint32_t              version;
+        std::uint32_t              capacity;     // of entries
+        std::atomic<std::uint64_t> sequence;     // odd while a snapshot is being written
+        std::uint64_t              pid;
+        std::uint64_t              published;    // ns since the Unix epoch, of the last snapshot
+        std::uint64_t              interval;     // ns between snapshots
+        std::uint64_t              count;        // entries in the last snapshot
+        std::uint64_t              omitted;      // entries of the last snapshot that didn't fit
+    };
+
+    // the stats of a site merged over every thread, like Ascopet::aggregate_report; durations in ns
+    struct Entry
+    {
+        char          name[name_length];
+        std::uint64_t count;    // calls, including the ones skipped by sampling
+        std::uint64_t sampled;
+        double        total;    // mean duration times count
+        double        mean;
+        double        median;
+        double        p99;
+        double        max;
+    };
+
+    static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "the sequence is shared across processes");
+    static_assert(sizeof(Header) == 64 and sizeof(Entry) == 120);
+
+    // name of the segment of a process, for shm_open
+    inline std::string segment_name(std::uint64_t pid)
+    {
+        return "/ascopet." + std::to_string(pid);
+    }
+
+    constexpr std::size_t segment_size(std::size_t capacity)
+    {
+        return sizeof(Header) + capacity * sizeof(Entry);
+    }
+}
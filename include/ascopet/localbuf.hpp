@@ -1,14 +1,25 @@
 #pragma once
 
-#include "ascopet/ascopet.hpp"
+#include "ascopet/common.hpp"
+#include "ascopet/spscbuf.hpp"
 
-#include <array>
+#include <algorithm>
 #include <atomic>
+#include <cstdint>
+#include <vector>
 
 namespace ascopet
 {
     class Ascopet;
 
+    // what a thread does with a record when its buffer is full
+    enum class Overflow
+    {
+        drop,         // drop the new record
+        overwrite,    // discard the oldest record in the buffer
+        block,        // yield until the worker makes room, for offline benchmarking (drops if tracing is paused)
+    };
+
     class LocalBuf
     {
     public:
@@ -20,38 +31,127 @@ namespace ascopet
         LocalBuf(const LocalBuf&)            = delete;
         LocalBuf& operator=(const LocalBuf&) = delete;
 
-        LocalBuf(Ascopet* ascopet) noexcept
-            : m_ascopet{ ascopet }
-            , m_buffers{ {
-                  { m_ascopet->localbuf_capacity() },
-                  { m_ascopet->localbuf_capacity() },
-              } }
+        LocalBuf(Ascopet* ascopet) noexcept;
+
+        // Registers a buffer for the calling thread. The instance owns it, so the worker can still drain it
+        // after its thread is gone.
+        static LocalBuf* attach(Ascopet* ascopet);
+
+        // called once by the owning thread as it exits, hands the buffer over to the worker
+        void detach();
+
+        // called by the worker thread only
+        template <std::invocable<const NamedRecord&> Fn>
+        std::size_t consume(Fn&& fn)
         {
-            m_ascopet->add_localbuf(std::this_thread::get_id(), *this);
+            auto consumed = m_buffer.consume(std::forward<Fn>(fn));
+            m_drained.store(m_drained.load(std::memory_order::relaxed) + consumed, std::memory_order::relaxed);
+            return consumed;
         }
 
-        ~LocalBuf() { m_ascopet->remove_localbuf(std::this_thread::get_id()); }
+        // approximate, lets the worker skip idle buffers without taking any lock
+        std::size_t size() const { return m_buffer.size(); }
 
-        RingBuf<NamedRecord>& swap() noexcept
+        // called by the owning thread only, returns false if the buffer is full
+        bool add_record(const NamedRecord& record) noexcept
         {
-            auto front = m_front.fetch_xor(1, Ord::acq_rel) ^ 1;    // emulate xor_fetch
-            return m_buffers[front];
+            auto result = m_buffer.push(record);
+            if (result == Push::crossed) [[unlikely]] {
+                wake_worker();
+            } else if (result == Push::full) [[unlikely]] {
+                return overflow(record);
+            }
+            return true;
         }
 
-        bool add_record(NamedRecord&& record) noexcept
+        // shadow stack of the owning thread's tracers, only its depth is needed: records arrive in the order their
+        // scopes end, so the scopes nested in a record are the deeper ones that arrived since its sibling
+        std::uint8_t enter() noexcept { return static_cast<std::uint8_t>(std::min(m_depth++, max_depth)); }
+        void         leave() noexcept { --m_depth; }
+        std::uint8_t depth() const noexcept { return static_cast<std::uint8_t>(std::min(m_depth, max_depth)); }
+
+        // called by the owning thread only, counts down to the next sample of the site; false if this call is
+        // skipped or the site disabled, otherwise `weight` is set to the number of calls since the previous
+        // sample, this one included
+        bool sample(SiteId site, std::uint32_t epoch, std::uint16_t& weight)
         {
-            auto back = m_front.load(Ord::relaxed) ^ 1;    // access the back buffer
-            m_buffers[back].push_back(std::move(record));
-            std::atomic_thread_fence(Ord::release);    // make sure record was written before swap
+            if (epoch != m_site_epoch) [[unlikely]] {
+                refresh_sites(epoch);
+            }
+            if (site >= m_samplers.size()) {
+                return true;
+            }
+
+            auto& sampler = m_samplers[site];
+            if (not sampler.enabled or --sampler.countdown > 0) {
+                return false;
+            }
+
+            weight            = sampler.gap;
+            sampler.gap       = next_gap(sampler.config);
+            sampler.countdown = sampler.gap;
             return true;
         }
 
+        // same for records that aren't sampled, like counters: only whether the site is enabled
+        bool is_enabled(SiteId site, std::uint32_t epoch)
+        {
+            if (epoch != m_site_epoch) [[unlikely]] {
+                refresh_sites(epoch);
+            }
+            return site >= m_samplers.size() or m_samplers[site].enabled;
+        }
+
+        // counters are cumulative since the thread's first trace, safe to read from any thread
+        std::uint64_t produced() const { return m_buffer.pushed() + dropped(); }
+        std::uint64_t drained() const { return m_drained.load(std::memory_order::relaxed); }
+        std::uint64_t overwritten() const { return m_overwritten.load(std::memory_order::relaxed); }
+        std::uint64_t dropped() const { return m_dropped.load(std::memory_order::relaxed); }
+        std::size_t   capacity() const { return m_buffer.capacity(); }
+
     private:
-        using Ord = std::memory_order;
+        // out of line, only taken when the buffer fills up to its watermark or is full
+        void wake_worker() noexcept;
+        bool overflow(const NamedRecord& record) noexcept;
+        void refresh_sites(std::uint32_t epoch);
+
+        struct Sampler
+        {
+            Sampling      config;
+            bool          enabled   = true;
+            std::uint16_t gap       = 1;    // calls between the previous sample and the next one
+            std::uint16_t countdown = 1;    // calls left until the next sample
+        };
+
+        std::uint16_t next_gap(const Sampling& config) noexcept
+        {
+            if (not config.random) {
+                return static_cast<std::uint16_t>(config.every);
+            }
+
+            // xorshift32, mapped onto [1, 2 * every - 1] with a multiply-shift so the mean gap stays `every`
+            m_rng ^= m_rng << 13;
+            m_rng ^= m_rng >> 17;
+            m_rng ^= m_rng << 5;
+            auto range = std::uint64_t{ 2 } * config.every - 1;
+            return static_cast<std::uint16_t>(1 + ((m_rng * range) >> 32));
+        }
+
+        static constexpr std::uint32_t max_depth = 255;
+
+        Ascopet*             m_ascopet = nullptr;
+        Overflow             m_overflow;
+        SpscBuf<NamedRecord> m_buffer;
+        std::uint32_t        m_depth = 0;    // owning thread
 
-        Ascopet* m_ascopet = nullptr;
+        // owning thread, a copy of the site configs as of m_site_epoch with each site's sampling progress
+        std::vector<Sampler> m_samplers;
+        std::uint32_t        m_site_epoch = 0;
+        std::uint32_t        m_rng        = 1;
 
-        std::array<RingBuf<NamedRecord>, 2> m_buffers;
-        std::atomic<std::uint64_t>          m_front = 0;
+        // each one is only written by one side, so no read-modify-write is needed
+        std::atomic<std::uint64_t> m_drained     = 0;    // worker
+        std::atomic<std::uint64_t> m_overwritten = 0;    // owning thread
+        std::atomic<std::uint64_t> m_dropped     = 0;    // owning thread
     };
 }
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "ascopet/site.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+// Layout of the files written by Ascopet::start_recording, in the byte order of the machine that wrote them.
+//
+// A file starts with a FileHeader followed by a sequence of chunks, each a ChunkHeader and `size` bytes of
+// payload, every chunk starting at an offset aligned to `chunk_align`. A file that wasn't closed properly ends
+// at the first chunk of kind `end`, which is what the zero-filled tail of the file reads as. Every file of a
+// rotation can be read on its own: a site or a thread is described again before its first record of a file.
+namespace ascopet::recording
+{
+    inline constexpr char          magic[8]    = { 'A', 'S', 'C', 'O', 'P', 'E', 'T', '\0' };
+    inline constexpr std::uint32_t version     = 2;
+    inline constexpr std::size_t   chunk_align = 8;
+
+    struct FileHeader
+    {
+        char          magic[8];
+        std::uint32_t version;
+        std::uint32_t index;    // position in the rotation, the first file is 0
+        std::uint64_t tsc_freq;
+        std::uint64_t overhead;               // calibrated overhead of Timing::fast, in ticks
+        std::uint64_t serialized_overhead;    // and of Timing::serialized
+        std::uint64_t block_records;          // the most records in a single `records` chunk
+    };
+
+    enum class ChunkKind : std::uint32_t
+    {
+        end     = 0,
+        site    = 1,    // SiteChunk, then `length` bytes of name
+        thread  = 2,    // ThreadChunk, then `length` bytes of name
+        records = 3,    // RecordsChunk, then `count` Records
+    };
+
+    struct ChunkHeader
+    {
+        ChunkKind     kind;
+        std::uint32_t size;    // of the payload, excluding the padding up to the next chunk
+    };
+
+    struct SiteChunk
+    {
+        SiteId        site;
+        std::uint32_t length;
+    };
+
+    struct ThreadChunk
+    {
+        std::uint32_t thread;    // numbered in order of appearance, shared by every file of a rotation
+        std::uint32_t length;
+        std::uint64_t tid;       // ThreadInfo::tid
+    };
+
+    struct RecordsChunk
+    {
+        std::uint32_t thread;
+        std::uint32_t count;
+    };
+
+    struct Record
+    {
+        SiteId        site;
+        std::uint32_t flags;    // NamedRecord::Flags in the low byte, then NamedRecord::depth, then weight (0 is 1)
+        std::uint64_t start;
+        std::uint64_t end;
+    };
+
+    static_assert(sizeof(FileHeader) == 48);
+    static_assert(sizeof(ChunkHeader) == 8 and sizeof(RecordsChunk) == 8 and sizeof(Record) == 24);
+
+    constexpr std::size_t padded(std::size_t size)
+    {
+        return (size + chunk_align - 1) / chunk_align * chunk_align;
+    }
+}
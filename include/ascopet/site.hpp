@@ -0,0 +1,83 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <source_location>
+#include <string_view>
+#include <vector>
+
+namespace ascopet
+{
+    // dense id of a registered trace site, used to index per-site data
+    using SiteId = std::uint32_t;
+
+    // sites sharing the same name share the same id and the location of the first registration
+    struct Site
+    {
+        std::string_view name;
+        std::string_view file;
+        std::uint32_t    line;
+    };
+
+    // string literal usable as a non-type template parameter: trace<"name">()
+    template <std::size_t N>
+    struct FixedString
+    {
+        constexpr FixedString(const char (&str)[N]) { std::copy_n(str, N, value); }
+        constexpr operator std::string_view() const { return { value, N - 1 }; }
+
+        char value[N];
+    };
+
+    // the registry is global and independent of the Ascopet instance, so sites can be registered before init
+    SiteId register_site(std::string_view name, std::source_location location = std::source_location::current());
+    SiteId register_site(std::source_location location);    // named after the function and line
+
+    // Site of a name built at runtime, e.g. "rpc/" + method: the name is copied into the registry on its first
+    // use and each thread remembers it by content afterwards, so a name interned again costs a compare with the
+    // thread's last one or a lookup in a thread-local table, and no allocation. The returned id is the handle to
+    // pass to trace(SiteId), which is as cheap as a static name; keep it instead of interning on every call.
+    SiteId intern(std::string_view name);
+
+    Site        site(SiteId id);
+    std::size_t site_count();
+
+    // Only one call out of `every` of a sampled site is timed and recorded, the others skip the timestamp reads
+    // and only count down. The record of a sampled call stands for the calls skipped before it, so the counts
+    // stay exact (but for the calls since the last sample of each thread) while every other stat is an
+    // estimate. With `random`, the gap to the next sample is drawn uniformly from [1, 2 * every - 1] instead of
+    // being fixed, so a period in the traced code can't alias with it.
+    struct Sampling
+    {
+        std::uint32_t every  = 1;    // at most max_sampling_gap, or half of it when random
+        bool          random = false;
+    };
+
+    inline constexpr std::uint32_t max_sampling_gap = 65535;
+
+    // global like the registry, applies to every thread from its next traced call on
+    void     set_sampling(SiteId id, Sampling sampling);
+    void     set_sampling(std::string_view name, Sampling sampling);
+    Sampling sampling(SiteId id);
+
+    // a disabled site is skipped like an unsampled call but isn't counted at all; same scope as the sampling
+    void set_enabled(SiteId id, bool enabled);
+    void set_enabled(std::string_view name, bool enabled);
+    bool is_enabled(SiteId id);
+
+    struct SiteConfig
+    {
+        Sampling sampling;
+        bool     enabled = true;
+    };
+
+    // config of every site with an id below the returned size, sites past it are enabled and not sampled
+    std::vector<SiteConfig> site_configs();
+
+    namespace detail
+    {
+        // bumped on every change of a SiteConfig, 0 as long as every site is enabled and not sampled
+        inline std::atomic<std::uint32_t> s_site_epoch = 0;
+    }
+}
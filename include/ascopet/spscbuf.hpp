@@ -0,0 +1,154 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <concepts>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <type_traits>
+
+namespace ascopet
+{
+    // NOTE: gcc warns about std::hardware_destructive_interference_size not being ABI stable, so hardcode it
+    inline constexpr std::size_t cache_line_size = 64;
+
+    enum class Push
+    {
+        pushed,
+        crossed,    // pushed, and the buffer just filled up to its watermark
+        full,       // dropped
+    };
+
+    // Single-producer single-consumer ring buffer. The producer is the thread owning the buffer and the
+    // consumer is the worker thread. Capacity is rounded up to the next power of two.
+    template <typename T>
+        requires std::default_initializable<T> and std::is_trivially_copyable_v<T>
+    class SpscBuf
+    {
+    public:
+        // a watermark above the capacity is never crossed
+        SpscBuf(std::size_t capacity, std::size_t watermark = std::numeric_limits<std::size_t>::max())
+            : m_capacity{ std::bit_ceil(capacity) }
+            , m_mask{ m_capacity - 1 }
+            , m_watermark{ watermark }
+            , m_buffer{ std::make_unique<T[]>(m_capacity) }
+        {
+            assert(capacity > 0);
+        }
+
+        SpscBuf(SpscBuf&&)            = delete;
+        SpscBuf& operator=(SpscBuf&&) = delete;
+
+        SpscBuf(const SpscBuf&)            = delete;
+        SpscBuf& operator=(const SpscBuf&) = delete;
+
+        // producer side, the record is dropped if the buffer is full
+        Push push(const T& value) noexcept
+        {
+            auto tail    = m_tail.load(Ord::relaxed);
+            auto crossed = false;
+
+            // NOTE: The fill seen through the cached head only grows one by one between refreshes, so each
+            // threshold is hit exactly, and only then the consumer's line is touched to get the real fill.
+            if (auto used = tail - m_head_cache; used == m_watermark or used == m_capacity) [[unlikely]] {
+                m_head_cache = m_head.load(Ord::acquire);
+                used         = tail - m_head_cache;
+                if (used == m_capacity) {
+                    return Push::full;
+                }
+                crossed = used >= m_watermark;
+            }
+
+            m_buffer[tail & m_mask] = value;
+            m_tail.store(tail + 1, Ord::release);    // publish the record
+            return crossed ? Push::crossed : Push::pushed;
+        }
+
+        // producer side, makes room by discarding the oldest record if the buffer is full; returns whether a
+        // record was discarded
+        bool push_overwrite(const T& value) noexcept
+        {
+            auto tail        = m_tail.load(Ord::relaxed);
+            auto head        = m_head.load(Ord::acquire);
+            auto overwritten = false;
+
+            // the consumer may free some slots concurrently, in which case there's nothing to discard
+            if (tail - head == m_capacity) {
+                overwritten = m_head.compare_exchange_strong(head, head + 1, Ord::acq_rel, Ord::acquire);
+                head        = overwritten ? head + 1 : head;
+            }
+            m_head_cache = head;
+
+            // NOTE: Once the head moved past a slot, a consumer that copied it can no longer claim it, so the
+            // write below is never handed out (see consume).
+            m_buffer[tail & m_mask] = value;
+            m_tail.store(tail + 1, Ord::release);
+            return overwritten;
+        }
+
+        // consumer side, calls fn on every record published when called and releases the slots back to the
+        // producer; records overwritten by the producer meanwhile are skipped
+        template <std::invocable<const T&> Fn>
+        std::size_t consume(Fn&& fn)
+        {
+            auto head     = m_head.load(Ord::acquire);
+            auto tail     = m_tail.load(Ord::acquire);
+            auto consumed = std::size_t{ 0 };
+
+            T staged[consume_batch];
+            while (head < tail) {
+                auto count = std::min(tail - head, consume_batch);
+                for (auto i = 0u; i < count; ++i) {
+                    staged[i] = m_buffer[(head + i) & m_mask];
+                }
+
+                // NOTE: A record is only handed out once its slot is claimed by moving the head past it. If the
+                // producer moved the head first, the records it discarded are counted by it as overwritten and
+                // the copies are retried from the oldest record it kept, so none is both consumed and lost.
+                if (not m_head.compare_exchange_strong(head, head + count, Ord::acq_rel, Ord::acquire)) {
+                    continue;
+                }
+                for (auto i = 0u; i < count; ++i) {
+                    fn(staged[i]);
+                }
+                head     += count;
+                consumed += count;
+            }
+
+            return consumed;
+        }
+
+        // approximate if called concurrently with push or consume
+        std::size_t size() const
+        {
+            return m_tail.load(Ord::acquire) - m_head.load(Ord::acquire);
+        }
+
+        // number of records ever pushed
+        std::size_t pushed() const { return m_tail.load(Ord::relaxed); }
+
+        std::size_t capacity() const { return m_capacity; }
+
+    private:
+        using Ord = std::memory_order;
+
+        // records copied out before each claim, bounds the retries when the producer keeps overwriting
+        static constexpr std::size_t consume_batch = 64;
+
+        // producer cache line
+        alignas(cache_line_size) std::atomic<std::size_t> m_tail = 0;
+        std::size_t m_head_cache                                 = 0;
+
+        // consumer cache line
+        alignas(cache_line_size) std::atomic<std::size_t> m_head = 0;
+
+        // read-only after construction
+        alignas(cache_line_size) const std::size_t m_capacity;
+        const std::size_t    m_mask;
+        const std::size_t    m_watermark;
+        std::unique_ptr<T[]> m_buffer;
+    };
+}
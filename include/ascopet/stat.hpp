@@ -0,0 +1,117 @@
+#pragma once
+
+#include "ascopet/histogram.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+namespace ascopet
+{
+    // Running count/sum/min/max and Welford mean/variance of tick values, updated in O(1) per value
+    class RunningStat
+    {
+    public:
+        RunningStat() = default;
+
+        // from moments computed elsewhere, `m2` being the sum of squared differences from the mean
+        RunningStat(
+            std::uint64_t count,
+            std::uint64_t sum,
+            std::uint64_t min,
+            std::uint64_t max,
+            double        mean,
+            double        m2
+        )
+            : m_count{ count }
+            , m_sum{ sum }
+            , m_min{ min }
+            , m_max{ max }
+            , m_mean{ mean }
+            , m_m2{ m2 }
+        {
+        }
+
+        void add(std::uint64_t value)
+        {
+            ++m_count;
+            m_sum += value;
+            m_min  = std::min(m_min, value);
+            m_max  = std::max(m_max, value);
+
+            auto delta  = static_cast<double>(value) - m_mean;
+            m_mean     += delta / static_cast<double>(m_count);
+            m_m2       += delta * (static_cast<double>(value) - m_mean);
+        }
+
+        // Chan et al. pairwise combination, the result is the same as if every value were added to one stat
+        void merge(const RunningStat& other)
+        {
+            if (other.m_count == 0) {
+                return;
+            } else if (m_count == 0) {
+                *this = other;
+                return;
+            }
+
+            auto count = m_count + other.m_count;
+            auto delta = other.m_mean - m_mean;
+            auto n_a   = static_cast<double>(m_count);
+            auto n_b   = static_cast<double>(other.m_count);
+            auto n     = static_cast<double>(count);
+
+            m_mean  += delta * n_b / n;
+            m_m2    += other.m_m2 + delta * delta * n_a * n_b / n;
+            m_count  = count;
+            m_sum   += other.m_sum;
+            m_min    = std::min(m_min, other.m_min);
+            m_max    = std::max(m_max, other.m_max);
+        }
+
+        void reset() { *this = {}; }
+
+        std::uint64_t count() const { return m_count; }
+        std::uint64_t sum() const { return m_sum; }
+        std::uint64_t min() const { return m_count ? m_min : 0; }
+        std::uint64_t max() const { return m_max; }
+
+        double mean() const { return m_mean; }
+        double variance() const { return m_count ? m_m2 / static_cast<double>(m_count) : 0.0; }
+        double stdev() const { return std::sqrt(variance()); }
+
+    private:
+        std::uint64_t m_count = 0;
+        std::uint64_t m_sum   = 0;
+        std::uint64_t m_min   = std::numeric_limits<std::uint64_t>::max();
+        std::uint64_t m_max   = 0;
+
+        double m_mean = 0.0;
+        double m_m2   = 0.0;
+    };
+
+    // running stat and quantile sketch of the same series of values, both mergeable
+    struct Summary
+    {
+        RunningStat stat;
+        Histogram   hist;
+
+        void add(std::uint64_t value)
+        {
+            stat.add(value);
+            hist.add(value);
+        }
+
+        void merge(const Summary& other)
+        {
+            stat.merge(other.stat);
+            hist.merge(other.hist);
+        }
+
+        void reset()
+        {
+            stat.reset();
+            hist.reset();
+        }
+    };
+}
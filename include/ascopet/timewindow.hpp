@@ -0,0 +1,94 @@
+#pragma once
+
+#include "ascopet/stat.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+namespace ascopet
+{
+    // Stats of the records started within the last `span` ticks, kept as a ring of tumbling buckets keyed on
+    // the start tick. Each bucket covers span / buckets ticks and is recycled once it falls out of the span, so
+    // the memory and the cost of a query only depend on the number of buckets, not on the call rate. A query
+    // merges the buckets of the last `span` ticks, the oldest of which may be only partially covered.
+    class TimeWindow
+    {
+    public:
+        struct Bucket
+        {
+            std::uint64_t epoch   = 0;    // start tick / width
+            std::uint64_t skipped = 0;    // calls skipped by sampling before the records of this bucket
+            Summary       duration;
+            Summary       interval;
+        };
+
+        TimeWindow(std::uint64_t span, std::size_t buckets)
+            : m_width{ std::max(span / std::max(buckets, std::size_t{ 1 }), std::uint64_t{ 1 }) }
+            , m_buckets(std::max(buckets, std::size_t{ 1 }))
+        {
+            assert(buckets > 0);
+        }
+
+        std::uint64_t width() const { return m_width; }
+        std::uint64_t epoch(std::uint64_t tick) const { return tick / m_width; }
+
+        // the bucket of the given epoch, null if its slot was already taken by a newer one
+        Bucket* at(std::uint64_t epoch)
+        {
+            auto& bucket = m_buckets[epoch % m_buckets.size()];
+            if (bucket.epoch > epoch) {
+                return nullptr;
+            } else if (bucket.epoch < epoch) {
+                bucket.epoch   = epoch;
+                bucket.skipped = 0;
+                bucket.duration.reset();
+                bucket.interval.reset();
+            }
+            return &bucket;
+        }
+
+        // merge the buckets covering the span that ends at `now`, returns the calls they skipped
+        std::uint64_t merge_to(std::uint64_t now, Summary& duration, Summary& interval) const
+        {
+            auto latest  = epoch(now);
+            auto skipped = std::uint64_t{ 0 };
+            for (const auto& bucket : m_buckets) {
+                if (bucket.epoch <= latest and bucket.epoch + m_buckets.size() > latest) {
+                    duration.merge(bucket.duration);
+                    interval.merge(bucket.interval);
+                    skipped += bucket.skipped;
+                }
+            }
+            return skipped;
+        }
+
+        // merges the buckets of a window with the same span and buckets, those older than this one's are lost
+        void merge(const TimeWindow& other)
+        {
+            assert(other.m_width == m_width and other.m_buckets.size() == m_buckets.size());
+            for (const auto& bucket : other.m_buckets) {
+                if (bucket.duration.stat.count() == 0) {
+                    continue;
+                }
+                if (auto* mine = at(bucket.epoch); mine) {
+                    mine->skipped += bucket.skipped;
+                    mine->duration.merge(bucket.duration);
+                    mine->interval.merge(bucket.interval);
+                }
+            }
+        }
+
+        void clear()
+        {
+            for (auto& bucket : m_buckets) {
+                bucket = {};
+            }
+        }
+
+    private:
+        std::uint64_t       m_width;
+        std::vector<Bucket> m_buckets;
+    };
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "ascopet/common.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <concepts>
+#include <cstdint>
+#include <span>
+#include <utility>
+
+namespace ascopet
+{
+    // Ring of the latest records of an entry stored as two separate arrays of starts and ends, so a scan over
+    // durations or intervals walks contiguous memory. The storage is a slab of 2 * capacity ticks it doesn't
+    // own (see SlabArena).
+    class RecordWindow
+    {
+    public:
+        using Run = std::span<const std::uint64_t>;
+
+        RecordWindow(std::uint64_t* slab, std::size_t capacity)
+            : m_starts{ slab }
+            , m_ends{ slab + capacity }
+            , m_capacity{ capacity }
+        {
+            assert(capacity > 0);
+        }
+
+        void push_back(std::uint64_t start, std::uint64_t end)
+        {
+            m_starts[m_next] = start;
+            m_ends[m_next]   = end;
+
+            if (++m_next == m_capacity) {
+                m_next = 0;
+            }
+            m_size = std::min(m_size + 1, m_capacity);
+        }
+
+        // oldest first
+        Record operator[](std::size_t pos) const
+        {
+            assert(pos < m_size);
+            auto index = first() + pos;
+            index      = index < m_capacity ? index : index - m_capacity;
+            return { m_starts[index], m_ends[index] };
+        }
+
+        // calls fn(starts, ends) on the at most two contiguous runs holding the `count` records from `pos`,
+        // oldest first
+        template <std::invocable<Run, Run> Fn>
+        void for_each_run(std::size_t pos, std::size_t count, Fn&& fn) const
+        {
+            pos   = std::min(pos, m_size);
+            count = std::min(count, m_size - pos);
+            if (count == 0) {
+                return;
+            }
+
+            auto head = first() + pos;
+            head      = head < m_capacity ? head : head - m_capacity;
+            auto len  = std::min(count, m_capacity - head);
+            fn(Run{ m_starts + head, len }, Run{ m_ends + head, len });
+
+            if (len < count) {
+                fn(Run{ m_starts, count - len }, Run{ m_ends, count - len });
+            }
+        }
+
+        // same for the latest `count` records
+        template <std::invocable<Run, Run> Fn>
+        void for_each_run(std::size_t count, Fn&& fn) const
+        {
+            count = std::min(count, m_size);
+            for_each_run(m_size - count, count, std::forward<Fn>(fn));
+        }
+
+        template <std::invocable<Run, Run> Fn>
+        void for_each_run(Fn&& fn) const
+        {
+            for_each_run(m_size, std::forward<Fn>(fn));
+        }
+
+        // keeps the latest records that fit in the other window
+        void copy_to(RecordWindow& other) const
+        {
+            auto skip = m_size > other.m_capacity ? m_size - other.m_capacity : 0;
+            other.clear();
+            for (auto i = skip; i < m_size; ++i) {
+                auto [start, end] = (*this)[i];
+                other.push_back(start, end);
+            }
+        }
+
+        void clear()
+        {
+            m_next = 0;
+            m_size = 0;
+        }
+
+        std::size_t size() const { return m_size; }
+        std::size_t capacity() const { return m_capacity; }
+
+    private:
+        std::size_t first() const { return m_size < m_capacity ? 0 : m_next; }
+
+        std::uint64_t* m_starts;
+        std::uint64_t* m_ends;
+        std::size_t    m_capacity;
+        std::size_t    m_next = 0;
+        std::size_t    m_size = 0;
+    };
+}
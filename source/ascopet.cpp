@@ -2,12 +2,31 @@
 #include "rdtsc.hpp"
 #endif
 
+#include "export.hpp"
+#include "kernel.hpp"
+#include "live.hpp"
+#include "pool.hpp"
+#include "recorder.hpp"
+
 #include "ascopet/ascopet.hpp"
 #include "ascopet/localbuf.hpp"
 
+#if defined(__linux__) or defined(__APPLE__)
+#include <pthread.h>
+#endif
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 #include <algorithm>
+#include <atomic>
+#include <bit>
 #include <cmath>
+#include <limits>
+#include <map>
 #include <mutex>
+#include <optional>
 #include <span>
 #include <vector>
 
@@ -15,145 +34,612 @@ using Fallback = std::chrono::steady_clock;
 
 namespace
 {
-    ascopet::Duration to_duration(std::uint64_t start, std::uint64_t end, std::uint64_t freq)
+    ascopet::TimingStat::Stat summary_stat(const ascopet::Summary& summary, const ascopet::kernel::TickScale& scale)
     {
-        return ascopet::Duration{ (end - start) * ascopet::Duration::period::den / freq };
+        const auto& [stat, hist] = summary;
+        if (stat.count() == 0) {
+            return {};
+        }
+
+        auto quantile = [&](double q) { return scale.to_stat(static_cast<double>(hist.quantile(q))); };
+
+        return {
+            .mean   = scale.to_stat(stat.mean()),
+            .median = quantile(0.5),
+            .stdev  = scale.to_stat(stat.stdev()),
+            .min    = scale.to_stat(static_cast<double>(stat.min())),
+            .max    = scale.to_stat(static_cast<double>(stat.max())),
+            .p90    = quantile(0.9),
+            .p99    = quantile(0.99),
+            .p999   = quantile(0.999),
+        };
     }
 
-    std::pair<std::vector<ascopet::Duration>, std::vector<ascopet::Duration>> split_duration_interval(
-        const ascopet::RingBuf<ascopet::Record>& records,
-        std::uint64_t                            freq
+    std::vector<ascopet::StatDuration> summary_quantiles(
+        const ascopet::Summary&           summary,
+        std::span<const double>           quantiles,
+        const ascopet::kernel::TickScale& scale
     )
     {
-        assert(records.size() >= 2);
+        auto values = std::vector<ascopet::StatDuration>{};
+        values.reserve(quantiles.size());
+        for (auto q : quantiles) {
+            values.push_back(scale.to_stat(static_cast<double>(summary.hist.quantile(q))));
+        }
+        return values;
+    }
 
-        auto durations = std::vector<ascopet::Duration>{};
-        auto intervals = std::vector<ascopet::Duration>{};
+    // folds x[i] = b[i] - a[i] - offset (see kernel::delta) into the summary
+    void fold_deltas(
+        ascopet::Summary&          summary,
+        ascopet::RecordWindow::Run a,
+        ascopet::RecordWindow::Run b,
+        std::uint64_t              offset
+    )
+    {
+        if (a.empty()) {
+            return;
+        }
 
-        durations.reserve(records.size());
-        intervals.reserve(records.size() - 1);
+        // the first value is as good a guess of the mean as any and doesn't need a pass of its own
+        auto pivot = static_cast<double>(ascopet::kernel::delta(a[0], b[0], offset));
+        auto stat  = ascopet::kernel::delta_stat(a.data(), b.data(), a.size(), offset, pivot);
+        summary.stat.merge(ascopet::kernel::to_running_stat(stat, pivot));
 
-        for (auto i = 0u; i < records.size(); ++i) {
-            auto [start, end] = records[i];
-            durations.push_back(to_duration(start, end, freq));
-            if (i > 0) {
-                auto dt = to_duration(records[i - 1].start, start, freq);
-                intervals.push_back(dt);
-            }
+        for (auto i = 0u; i < a.size(); ++i) {
+            summary.hist.add(ascopet::kernel::delta(a[i], b[i], offset));
         }
+    }
 
-        return { std::move(durations), std::move(intervals) };
+    // folds one run of consecutive records, intervals are the deltas of consecutive starts with the first one
+    // linked to `prev`; returns the start of the last record
+    std::uint64_t fold_run(
+        ascopet::Summary&            duration,
+        ascopet::Summary&            interval,
+        ascopet::RecordWindow::Run   starts,
+        ascopet::RecordWindow::Run   ends,
+        std::uint64_t                overhead,
+        std::optional<std::uint64_t> prev
+    )
+    {
+        fold_deltas(duration, starts, ends, overhead);
+        if (prev) {
+            interval.add(ascopet::kernel::delta(*prev, starts.front(), 0));
+        }
+        fold_deltas(interval, starts.first(starts.size() - 1), starts.subspan(1), 0);
+        return starts.back();
     }
 
-    ascopet::TimingStat calculate_stat(const ascopet::RingBuf<ascopet::Record>& records, std::uint64_t freq)
+    // folds the `count` records of the window from `pos`, returns the start of the last one
+    std::optional<std::uint64_t> fold_range(
+        ascopet::Summary&            duration,
+        ascopet::Summary&            interval,
+        const ascopet::RecordWindow& records,
+        std::size_t                  pos,
+        std::size_t                  count,
+        std::uint64_t                overhead,
+        std::optional<std::uint64_t> prev
+    )
     {
-        using namespace ascopet;
+        records.for_each_run(pos, count, [&](ascopet::RecordWindow::Run starts, ascopet::RecordWindow::Run ends) {
+            prev = fold_run(duration, interval, starts, ends, overhead, prev);
+        });
+        return prev;
+    }
 
-        if (const auto size = records.size(); size == 0) {
-            return {};
-        } else if (size < 2) {
-            auto dur = to_duration(records[0].start, records[0].end, freq);
-            return {
-                .duration = {
-                    .mean   = dur,
-                    .median = dur,
-                    .stdev  = {},
-                    .min    = dur,
-                    .max    = dur,
-                },
-                .interval = {
-                    .mean   = {},
-                    .median = {},
-                    .stdev  = {},
-                    .min    = {},
-                    .max    = {},
-                },
-                .count = 1,
-            };
+    // folds the latest `count` records of the window, returns the start of the last one
+    std::optional<std::uint64_t> fold_window(
+        ascopet::Summary&            duration,
+        ascopet::Summary&            interval,
+        const ascopet::RecordWindow& records,
+        std::size_t                  count,
+        std::uint64_t                overhead,
+        std::optional<std::uint64_t> prev
+    )
+    {
+        count = std::min(count, records.size());
+        return fold_range(duration, interval, records, records.size() - count, count, overhead, prev);
+    }
+
+    using Overheads = std::vector<std::pair<std::uint64_t, std::uint64_t>>;
+
+    // calls fn(pos, count, overhead) on the consecutive ranges of the latest `count` records of a window that
+    // were pushed with the same overhead, oldest first; `seq` is the number of records ever pushed to it
+    template <typename Fn>
+    void for_each_overhead(
+        const Overheads&             overheads,
+        std::uint64_t                seq,
+        const ascopet::RecordWindow& records,
+        std::size_t                  count,
+        Fn&&                         fn
+    )
+    {
+        count = std::min(count, records.size());
+
+        auto pos   = records.size() - count;
+        auto first = seq - count;    // seq of the record at `pos`
+        for (auto i = 0u; i < overheads.size() and first < seq; ++i) {
+            auto end = i + 1 < overheads.size() ? std::min(overheads[i + 1].first, seq) : seq;
+            if (end <= first) {
+                continue;
+            }
+            fn(pos, static_cast<std::size_t>(end - first), overheads[i].second);
+            pos   += static_cast<std::size_t>(end - first);
+            first  = end;
         }
+    }
 
-        auto [durations, intervals] = split_duration_interval(records, freq);
+    // the records from `seq` on are pushed with `overhead`; the first segments go once the window no longer holds
+    // any of their records, `oldest` being the seq of its oldest record after the push
+    void add_overhead(Overheads& overheads, std::uint64_t seq, std::uint64_t overhead, std::uint64_t oldest)
+    {
+        if (overheads.empty() or overheads.back().second != overhead) {
+            overheads.emplace_back(seq, overhead);
+        }
+        auto obsolete = std::find_if(overheads.begin() + 1, overheads.end(), [&](auto& o) { return o.first > oldest; });
+        overheads.erase(overheads.begin(), obsolete - 1);
+    }
 
-        const auto mean_stdev_min_max = [](std::span<const Duration> durations) -> std::array<Duration, 4> {
-            auto min = Duration{ std::numeric_limits<Duration::rep>::max() };
-            auto max = Duration{ std::numeric_limits<Duration::rep>::min() };
-            auto sum = Duration{ 0 };
+    // same as fold_window but into the buckets of a time window; the starts of an entry are mostly increasing,
+    // so a run is split into a few long stretches of records that fall into the same bucket
+    void fold_buckets(
+        ascopet::TimeWindow&         window,
+        const ascopet::RecordWindow& records,
+        std::size_t                  count,
+        std::uint64_t                overhead,
+        std::optional<std::uint64_t> prev
+    )
+    {
+        records.for_each_run(count, [&](ascopet::RecordWindow::Run starts, ascopet::RecordWindow::Run ends) {
+            while (not starts.empty()) {
+                auto epoch = window.epoch(starts.front());
+                auto begin = epoch * window.width();
+                auto end   = begin + window.width();
+
+                auto len = std::size_t{ 1 };
+                while (len < starts.size() and starts[len] >= begin and starts[len] < end) {
+                    ++len;
+                }
 
-            for (auto dur : durations) {
-                sum += dur;
-                if (dur < min) {
-                    min = dur;
-                } else if (dur > max) {
-                    max = dur;
+                // records older than the whole window are dropped, they'd never be reported anyway
+                if (auto* bucket = window.at(epoch); bucket) {
+                    fold_run(bucket->duration, bucket->interval, starts.first(len), ends.first(len), overhead, prev);
                 }
-            }
-            auto avg = sum / static_cast<Duration::rep>(durations.size());
 
-            auto diff_sum = 0.0;
-            for (auto dur : durations) {
-                auto diff  = static_cast<double>(dur.count() - avg.count());
-                diff_sum  += diff * diff;
+                prev   = starts[len - 1];
+                starts = starts.subspan(len);
+                ends   = ends.subspan(len);
             }
-            auto stdev = std::sqrt(diff_sum / static_cast<double>(durations.size()));
+        });
+    }
 
-            return { avg, Duration{ static_cast<Duration::rep>(stdev) }, min, max };
-        };
+    std::vector<std::uint64_t> window_ticks(const std::vector<ascopet::Duration>& windows, std::uint64_t freq)
+    {
+        auto ticks = std::vector<std::uint64_t>{};
+        for (auto window : windows) {
+            auto seconds = std::chrono::duration<double>{ window }.count();
+            ticks.push_back(static_cast<std::uint64_t>(std::max(seconds, 0.0) * static_cast<double>(freq)));
+        }
+        return ticks;
+    }
+
+    std::uint64_t median(std::vector<std::uint64_t>& ticks)
+    {
+        auto mid = ticks.begin() + static_cast<std::ptrdiff_t>(ticks.size() / 2);
+        std::nth_element(ticks.begin(), mid, ticks.end());
+        return *mid;
+    }
+
+    // exact medians need the whole window to be copied and partially sorted, so it's opt-in
+    // the durations have the overhead they were pushed with subtracted like the folded ones, so the median agrees
+    // with the other stats
+    void exact_median(
+        ascopet::TimingStat&              stat,
+        const ascopet::RecordWindow&      records,
+        const Overheads&                  overheads,
+        std::uint64_t                     seq,
+        const ascopet::kernel::TickScale& scale
+    )
+    {
+        if (records.size() == 0) {
+            return;
+        }
 
-        auto [dur_mean, dur_stdev, dur_min, dur_max]         = mean_stdev_min_max(durations);
-        auto [intvl_mean, intvl_stdev, intvl_min, intvl_max] = mean_stdev_min_max(intervals);
+        auto durations = std::vector<std::uint64_t>{};
+        auto intervals = std::vector<std::uint64_t>{};
 
-        auto dur_mid = durations.begin() + durations.size() / 2;
-        std::nth_element(durations.begin(), dur_mid, durations.end());
+        durations.reserve(records.size());
+        intervals.reserve(records.size() - 1);
 
-        auto intvl_mid = intervals.begin() + intervals.size() / 2;
-        std::nth_element(intervals.begin(), intvl_mid, intervals.end());
+        // the median is taken on ticks, only the result is converted
+        auto prev_start = records[0].start;
+        for_each_overhead(overheads, seq, records, records.size(), [&](auto pos, auto count, auto overhead) {
+            records.for_each_run(pos, count, [&](ascopet::RecordWindow::Run starts, ascopet::RecordWindow::Run ends) {
+                for (auto i = 0u; i < starts.size(); ++i) {
+                    durations.push_back(ascopet::kernel::delta(starts[i], ends[i], overhead));
+                }
+                for (auto start : starts) {
+                    intervals.push_back(ascopet::kernel::delta(prev_start, start, 0));
+                    prev_start = start;
+                }
+            });
+        });
+        intervals.erase(intervals.begin());    // the first record has no predecessor
 
-        return {
-            .duration = {
-                .mean   = dur_mean,
-                .median = durations[durations.size() / 2],
-                .stdev  = dur_stdev,
-                .min    = dur_min,
-                .max    = dur_max,
-            },
-            .interval = {
-                .mean   = intvl_mean,
-                .median = intervals[intervals.size() / 2],
-                .stdev  = intvl_stdev,
-                .min    = intvl_min,
-                .max    = intvl_max,
-            },
-            .count = records.actual_count(),
-        };
+        stat.duration.median = scale.to_stat(static_cast<double>(median(durations)));
+        if (not intervals.empty()) {
+            stat.interval.median = scale.to_stat(static_cast<double>(median(intervals)));
+        }
+    }
+
+    // names and locations passed at runtime are required to have static lifetime, so their addresses are
+    // stable and can be used as a cheap per-thread key instead of hashing the whole string every call
+    struct LiteralKey
+    {
+        const char* str;
+        std::size_t len;
+
+        bool operator==(const LiteralKey&) const = default;
+    };
+
+    struct LiteralKeyHash
+    {
+        std::size_t operator()(const LiteralKey& key) const
+        {
+            return std::hash<const char*>{}(key.str) ^ (key.len * 0x9e3779b97f4a7c15ull);
+        }
+    };
+
+    // the cost of an empty traced scope is the distance between its two back to back timestamp reads
+    template <ascopet::Timing T>
+    std::uint64_t calibrate_overhead()
+    {
+        constexpr auto samples = 4096;
+
+        auto deltas = std::vector<std::uint64_t>(samples);
+        for (auto& delta : deltas) {
+            auto start = ascopet::start_stamp<T>();
+            auto end   = ascopet::end_stamp<T>();
+            delta      = end - start;
+        }
+
+        // median instead of min: an empty scope is rarely the luckiest case either
+        auto mid = deltas.begin() + samples / 2;
+        std::nth_element(deltas.begin(), mid, deltas.end());
+        return *mid;
+    }
+
+    // the number of records at which a producer wakes the worker, relative to the rounded up capacity; a
+    // watermark at the capacity would never be reported since the push that reaches it finds the buffer full
+    std::size_t wake_watermark(std::size_t capacity, double fill)
+    {
+        if (fill <= 0.0) {
+            return std::numeric_limits<std::size_t>::max();
+        }
+        auto actual = static_cast<double>(std::bit_ceil(capacity));
+        return static_cast<std::size_t>(std::clamp(std::ceil(fill * actual), 1.0, std::max(actual - 1.0, 1.0)));
+    }
+
+    // set once this thread's buffer is handed over so tracing during thread exit doesn't resurrect it
+    thread_local bool t_retired = false;
+
+    // the calling thread's end of its buffer, which the instance owns
+    struct ThreadBuffer
+    {
+        ascopet::LocalBuf* buffer;
+
+        ~ThreadBuffer()
+        {
+            ascopet::detail::s_localbuf = nullptr;
+            t_retired                   = true;
+            buffer->detach();
+        }
+    };
+
+    // a list that lost its entries gets a new id, so a cursor that read the old ones starts over
+    std::atomic<std::uint64_t> s_list_id = 0;
+
+    ascopet::ThreadInfo current_thread_info()
+    {
+        auto info = ascopet::ThreadInfo{};
+#if defined(__linux__)
+        info.tid = static_cast<std::uint64_t>(::syscall(SYS_gettid));
+#elif defined(__APPLE__)
+        ::pthread_threadid_np(nullptr, &info.tid);
+#else
+        info.tid = std::hash<std::thread::id>{}(std::this_thread::get_id());
+#endif
+
+#if defined(__linux__) or defined(__APPLE__)
+        char name[64] = {};
+        if (::pthread_getname_np(::pthread_self(), name, sizeof(name)) == 0) {
+            info.name = name;
+        }
+#endif
+        return info;
     }
 }
 
 namespace ascopet
 {
-    TimingList::TimingList(std::size_t capacity)
-        : m_capacity{ capacity }
+    TimingList::TimingList(
+        std::size_t                capacity,
+        std::vector<std::uint64_t> windows,
+        std::size_t                window_buckets,
+        bool                       call_tree
+    )
+        : m_id{ ++s_list_id }
+        , m_capacity{ capacity }
+        , m_windows{ std::move(windows) }
+        , m_window_buckets{ window_buckets }
+        , m_arena{ 2 * capacity }
+        , m_call_tree{ call_tree }
     {
         assert(capacity > 0);
     }
 
-    void TimingList::push_back(const NamedRecord& record)
+    TimingList::Entry& TimingList::entry(SiteId site)
+    {
+        if (site >= m_entries.size()) {
+            m_entries.resize(site + 1);
+        }
+
+        auto& entry = m_entries[site];
+        if (not entry) {
+            entry.emplace(RecordWindow{ m_arena.acquire(), m_capacity });
+            for (auto span : m_windows) {
+                entry->windows.emplace_back(span, m_window_buckets);
+            }
+        }
+        return *entry;
+    }
+
+    void TimingList::push_back(const NamedRecord& record, std::uint64_t overhead)
     {
-        auto it = m_records.find(record.name);
-        if (it != m_records.end()) {
-            it->second.push_back({ record.start, record.end });
+        if (record.kind() != NamedRecord::scope) {
+            push_event(record);
+            return;
+        }
+
+        auto& entry = this->entry(record.site);
+
+        // the window must not overwrite records that weren't folded yet, and a fold uses a single overhead
+        if (entry.pending == m_capacity or (entry.pending > 0 and entry.overhead != overhead)) {
+            fold(entry);
+        }
+        if (entry.pending++ == 0) {
+            m_pending.push_back(record.site);
+        }
+
+        if (entry.overheads.empty() or entry.overheads.back().second != overhead) {
+            auto oldest = entry.seq + 1 - std::min<std::uint64_t>(entry.records.size() + 1, m_capacity);
+            add_overhead(entry.overheads, entry.seq, overhead, oldest);
+        }
+
+        entry.records.push_back(record.start, record.end);
+        entry.overhead = overhead;
+        entry.seq += 1;
+        m_generation += 1;
+
+        // NOTE: a record only keeps its start and end in the window, the calls it stands for are counted now
+        auto skipped = std::max(record.weight, std::uint16_t{ 1 }) - 1u;
+        entry.calls += skipped + 1;
+        if (skipped > 0) {
+            entry.skipped += skipped;
+            for (auto& window : entry.windows) {
+                if (auto* bucket = window.at(window.epoch(record.start)); bucket) {
+                    bucket->skipped += skipped;
+                }
+            }
+        }
+
+        // NOTE: a span may have begun on another thread, it has no place in this thread's call tree
+        if ((record.flags & NamedRecord::detached) != 0) {
+            return;
+        }
+
+        if (m_call_tree) {
+            m_calls.add(record.site, record.depth, kernel::delta(record.start, record.end, overhead));
+        }
+        if (not m_attached.empty()) {
+            settle_attached(record.site, record.depth, kernel::delta(record.start, record.end, overhead));
+        }
+    }
+
+    void TimingList::push_event(const NamedRecord& record)
+    {
+        if (record.site >= m_events.size()) {
+            m_events.resize(record.site + 1);
+        }
+
+        auto& events = m_events[record.site];
+        if (not events) {
+            events.emplace();
+            events->kind = record.kind();
+        }
+        if (events->values.count() == 0) {
+            events->first_stamp = record.start;
+        }
+
+        events->values.add(record.end);
+        events->last       = record.end;
+        events->last_stamp = record.start;
+
+        if ((record.flags & NamedRecord::attached) == 0) {
+            return;
+        }
+
+        if (m_attached.size() <= record.depth) {
+            m_attached.resize(record.depth + 1u);
+        }
+        auto& pending = m_attached[record.depth];
+        auto  it      = std::find_if(pending.begin(), pending.end(), [&](auto& p) { return p.first == record.site; });
+        if (it == pending.end()) {
+            pending.emplace_back(record.site, record.end);
         } else {
-            auto [it, _] = m_records.emplace(record.name, m_capacity);
-            it->second.push_back({ record.start, record.end });
+            it->second += record.end;
+        }
+    }
+
+    void TimingList::settle_attached(SiteId scope, std::uint8_t depth, std::uint64_t duration)
+    {
+        // deeper increments still waiting lost their scope to a dropped or overwritten record
+        for (auto i = depth + 1u; i < m_attached.size(); ++i) {
+            m_attached[i].clear();
+        }
+        if (depth >= m_attached.size()) {
+            return;
+        }
+
+        for (auto [counter, sum] : m_attached[depth]) {
+            auto& scopes = m_events[counter]->scopes;
+            auto  it = std::find_if(scopes.begin(), scopes.end(), [&](auto& s) { return s.scope == scope; });
+            if (it == scopes.end()) {
+                scopes.push_back({ .scope = scope, .sum = sum, .ticks = duration });
+            } else {
+                it->sum   += sum;
+                it->ticks += duration;
+            }
+        }
+        m_attached[depth].clear();
+    }
+
+    void TimingList::flush()
+    {
+        for (auto site : m_pending) {
+            if (auto& entry = m_entries[site]; entry and entry->pending > 0) {
+                fold(*entry);
+            }
+        }
+        m_pending.clear();
+    }
+
+    void TimingList::fold(Entry& entry)
+    {
+        for (auto& window : entry.windows) {
+            fold_buckets(window, entry.records, entry.pending, entry.overhead, entry.last_start);
+        }
+        entry.last_start = fold_window(
+            entry.duration, entry.interval, entry.records, entry.pending, entry.overhead, entry.last_start
+        );
+        entry.pending = 0;
+    }
+
+    void TimingList::absorb(const TimingList& other)
+    {
+        // the records taken over are folded already, the pending ones of this list must not be mixed with them
+        flush();
+
+        for (auto id = 0u; id < other.m_entries.size(); ++id) {
+            const auto& from = other.m_entries[id];
+            if (not from) {
+                continue;
+            }
+
+            auto& to = entry(static_cast<SiteId>(id));
+            to.duration.merge(from->duration);
+            to.interval.merge(from->interval);
+            to.skipped += from->skipped;
+            to.calls   += from->calls;
+
+            // the records still in the other window are pushed as folded ones, the ones it lost count as overwritten
+            auto count = std::min(from->records.size(), m_capacity);
+            auto copy  = [&](std::size_t pos, std::size_t len, std::uint64_t overhead) {
+                auto oldest = to.seq + len - std::min<std::uint64_t>(to.records.size() + len, m_capacity);
+                add_overhead(to.overheads, to.seq, overhead, oldest);
+                from->records.for_each_run(pos, len, [&](RecordWindow::Run starts, RecordWindow::Run ends) {
+                    for (auto i = 0u; i < starts.size(); ++i) {
+                        to.records.push_back(starts[i], ends[i]);
+                    }
+                });
+                to.seq += len;
+            };
+            for_each_overhead(from->overheads, from->seq, from->records, count, copy);
+            to.lost      += from->lost + (from->seq - count);
+            m_generation += 1;
+
+            // the other list may have been made with other windows, only matching ones can be merged
+            if (m_windows == other.m_windows and m_window_buckets == other.m_window_buckets) {
+                for (auto i = 0u; i < to.windows.size(); ++i) {
+                    to.windows[i].merge(from->windows[i]);
+                }
+            }
+        }
+
+        if (m_call_tree) {
+            m_calls.absorb(other.m_calls);
+        }
+
+        if (m_events.size() < other.m_events.size()) {
+            m_events.resize(other.m_events.size());
+        }
+        for (auto id = 0u; id < other.m_events.size(); ++id) {
+            const auto& from = other.m_events[id];
+            if (not from) {
+                continue;
+            }
+
+            auto& to = m_events[id];
+            if (not to or to->values.count() == 0) {
+                to = from;
+                continue;
+            } else if (from->values.count() == 0) {
+                continue;
+            }
+
+            to->values.merge(from->values);
+            to->first_stamp = std::min(to->first_stamp, from->first_stamp);
+            if (from->last_stamp >= to->last_stamp) {
+                to->last       = from->last;
+                to->last_stamp = from->last_stamp;
+            }
+            for (const auto& scope : from->scopes) {
+                auto match = [&](const Events::Attached& s) { return s.scope == scope.scope; };
+                if (auto it = std::find_if(to->scopes.begin(), to->scopes.end(), match); it != to->scopes.end()) {
+                    it->sum   += scope.sum;
+                    it->ticks += scope.ticks;
+                } else {
+                    to->scopes.push_back(scope);
+                }
+            }
         }
     }
 
     void TimingList::clear(bool remove_entries)
     {
+        m_pending.clear();
+        m_calls.clear();
+        m_attached.clear();
         if (remove_entries) {
-            m_records.clear();
+            m_events.clear();
         } else {
-            for (auto& [name, records] : m_records) {
-                records.clear();
+            for (auto& events : m_events) {
+                if (events) {
+                    events->values.reset();
+                    events->last = 0;
+                    events->scopes.clear();
+                }
+            }
+        }
+
+        if (remove_entries) {
+            m_id = ++s_list_id;
+            m_entries.clear();
+            m_arena.reset();    // keep the slabs for the next entries
+        } else {
+            for (auto& entry : m_entries) {
+                if (entry) {
+                    entry->records.clear();
+                    entry->overheads.clear();
+                    entry->duration.reset();
+                    entry->interval.reset();
+                    entry->last_start.reset();    // the first interval after a clear must not span it
+                    entry->pending = 0;
+                    entry->skipped = 0;
+                    for (auto& window : entry->windows) {
+                        window.clear();
+                    }
+                }
             }
         }
     }
@@ -163,73 +649,344 @@ namespace ascopet
         if (new_capacity == m_capacity) {
             return;
         }
-        for (auto& [_, records] : m_records) {
-            records.resize(new_capacity);
+
+        // records that don't fit in the new window would be lost before being folded
+        flush();
+
+        // every slab of an arena has the same size, so the windows move to a new one
+        auto arena = SlabArena{ 2 * new_capacity };
+        for (auto& entry : m_entries) {
+            if (entry) {
+                auto records = RecordWindow{ arena.acquire(), new_capacity };
+                entry->records.copy_to(records);
+                entry->records = records;
+            }
+        }
+
+        m_capacity = new_capacity;
+        m_arena    = std::move(arena);
+    }
+
+    StrMap<TimingStat> TimingList::stat(std::uint64_t freq, bool exact) const
+    {
+        auto scale   = kernel::TickScale{ freq };
+        auto reports = StrMap<TimingStat>{};
+        for (auto id = 0u; id < m_entries.size(); ++id) {
+            const auto& entry = m_entries[id];
+            if (not entry) {
+                continue;
+            }
+
+            auto sampled = entry->duration.stat.count();
+            auto stat    = TimingStat{
+                .duration    = summary_stat(entry->duration, scale),
+                .interval    = summary_stat(entry->interval, scale),
+                .count       = sampled + entry->skipped,
+                .sampled     = sampled,
+                .overwritten = sampled - (entry->records.size() - entry->pending),
+            };
+            if (exact) {
+                exact_median(stat, entry->records, entry->overheads, entry->seq, scale);
+            }
+
+            reports.emplace(site(id).name, stat);
+        }
+        return reports;
+    }
+
+    StrMap<TimingStat> TimingList::stat_since(std::uint64_t freq, Cursor& cursor) const
+    {
+        if (cursor.list != m_id) {
+            cursor = Cursor{ .list = m_id, .generation = 0, .seen = {}, .calls = {}, .lost = {} };
+        } else if (cursor.generation == m_generation) {
+            return {};
+        }
+
+        cursor.generation = m_generation;
+        cursor.seen.resize(m_entries.size());
+        cursor.calls.resize(m_entries.size());
+        cursor.lost.resize(m_entries.size());
+
+        auto scale   = kernel::TickScale{ freq };
+        auto reports = StrMap<TimingStat>{};
+        for (auto id = 0u; id < m_entries.size(); ++id) {
+            const auto& entry = m_entries[id];
+            if (not entry or (entry->seq == cursor.seen[id] and entry->lost == cursor.lost[id])) {
+                continue;
+            }
+
+            auto fresh     = entry->seq - cursor.seen[id];
+            auto lost      = entry->lost - cursor.lost[id];
+            auto available = std::min<std::uint64_t>(fresh, entry->records.size());
+            auto skipped   = entry->records.size() - available;
+
+            auto prev     = skipped > 0 ? std::optional{ entry->records[skipped - 1].start } : std::nullopt;
+            auto duration = Summary{};
+            auto interval = Summary{};
+            auto fold     = [&](std::size_t pos, std::size_t count, std::uint64_t overhead) {
+                prev = fold_range(duration, interval, entry->records, pos, count, overhead, prev);
+            };
+            for_each_overhead(entry->overheads, entry->seq, entry->records, available, fold);
+
+            reports.emplace(
+                site(id).name,
+                TimingStat{
+                    .duration    = summary_stat(duration, scale),
+                    .interval    = summary_stat(interval, scale),
+                    .count       = entry->calls - cursor.calls[id],
+                    .sampled     = fresh + lost,
+                    .overwritten = fresh - available + lost,
+                }
+            );
+            cursor.seen[id]  = entry->seq;
+            cursor.calls[id] = entry->calls;
+            cursor.lost[id]  = entry->lost;
         }
+        return reports;
     }
 
-    StrMap<TimingStat> TimingList::stat(std::uint64_t freq) const
+    StrMap<TimingStat> TimingList::window_stat(std::uint64_t freq, std::size_t window, std::uint64_t now) const
     {
+        auto scale   = kernel::TickScale{ freq };
         auto reports = StrMap<TimingStat>{};
-        for (const auto& [name, records] : m_records) {
-            reports.emplace(name, calculate_stat(records, freq));
+        for (auto id = 0u; id < m_entries.size(); ++id) {
+            const auto& entry = m_entries[id];
+            if (not entry or window >= entry->windows.size()) {
+                continue;
+            }
+
+            auto duration = Summary{};
+            auto interval = Summary{};
+            auto skipped  = entry->windows[window].merge_to(now, duration, interval);
+            if (duration.stat.count() == 0) {
+                continue;
+            }
+
+            reports.emplace(
+                site(id).name,
+                TimingStat{
+                    .duration    = summary_stat(duration, scale),
+                    .interval    = summary_stat(interval, scale),
+                    .count       = duration.stat.count() + skipped,
+                    .sampled     = duration.stat.count(),
+                    .overwritten = 0,
+                }
+            );
+        }
+        return reports;
+    }
+
+    StrMap<QuantileStat> TimingList::quantiles(std::uint64_t freq, std::span<const double> quantiles) const
+    {
+        auto scale   = kernel::TickScale{ freq };
+        auto reports = StrMap<QuantileStat>{};
+        for (auto id = 0u; id < m_entries.size(); ++id) {
+            if (const auto& entry = m_entries[id]; entry) {
+                reports.emplace(
+                    site(id).name,
+                    QuantileStat{
+                        .duration = summary_quantiles(entry->duration, quantiles, scale),
+                        .interval = summary_quantiles(entry->interval, quantiles, scale),
+                    }
+                );
+            }
         }
         return reports;
     }
 
+    std::size_t TimingList::merge_summary(
+        SiteId         site,
+        Summary&       duration,
+        Summary&       interval,
+        std::uint64_t& skipped
+    ) const
+    {
+        if (site >= m_entries.size() or not m_entries[site]) {
+            return 0;
+        }
+
+        duration.merge(m_entries[site]->duration);
+        interval.merge(m_entries[site]->interval);
+        skipped += m_entries[site]->skipped;
+        return m_entries[site]->records.size() - m_entries[site]->pending;
+    }
+
+    std::size_t TimingList::site_bound() const
+    {
+        return m_entries.size();
+    }
+
     StrMap<RingBuf<Record>> TimingList::records() const
     {
-        return m_records;
+        auto records = StrMap<RingBuf<Record>>{};
+        for (auto id = 0u; id < m_entries.size(); ++id) {
+            if (const auto& entry = m_entries[id]; entry) {
+                auto [it, _] = records.emplace(site(id).name, RingBuf<Record>{ m_capacity });
+                for (auto i = 0u; i < entry->records.size(); ++i) {
+                    it->second.push_back(entry->records[i]);
+                }
+            }
+        }
+        return records;
+    }
+
+    StrMap<CounterStat> TimingList::counter_stat(std::uint64_t freq) const
+    {
+        auto scale   = kernel::TickScale{ freq };
+        auto per_sec = [&](std::uint64_t amount, std::uint64_t ticks) {
+            return ticks > 0 ? static_cast<double>(amount) * static_cast<double>(freq) / static_cast<double>(ticks)
+                             : 0.0;
+        };
+
+        auto reports = StrMap<CounterStat>{};
+        for (auto id = 0u; id < m_events.size(); ++id) {
+            const auto& events = m_events[id];
+            if (not events) {
+                continue;
+            }
+
+            const auto& values = events->values;
+            auto        amount = events->kind == NamedRecord::counter ? values.sum() : values.count();
+
+            auto stat = CounterStat{
+                .kind   = events->kind,
+                .count  = values.count(),
+                .sum    = values.sum(),
+                .last   = events->last,
+                .min    = values.min(),
+                .max    = values.max(),
+                .mean   = values.mean(),
+                .rate   = per_sec(amount, events->last_stamp - events->first_stamp),
+                .scopes = {},
+            };
+            for (const auto& scope : events->scopes) {
+                stat.scopes.emplace(
+                    site(scope.scope).name,
+                    CounterStat::Throughput{
+                        .sum        = scope.sum,
+                        .time       = scale.to_stat(static_cast<double>(scope.ticks)),
+                        .per_second = per_sec(scope.sum, scope.ticks),
+                    }
+                );
+            }
+
+            reports.emplace(site(id).name, std::move(stat));
+        }
+        return reports;
     }
 }
 
 namespace ascopet
 {
-    Tracer::Tracer(LocalBuf* buffer, std::string_view name)
-        : m_buffer{ buffer }
-        , m_name{ name }
-#if not defined(ASCOPET_DISABLE_RDTSC)
-        , m_start{ __rdtsc() }
-#else
-        , m_start{ static_cast<std::uint64_t>(Fallback::now().time_since_epoch().count()) }
-#endif
+    LocalBuf::LocalBuf(Ascopet* ascopet) noexcept
+        : m_ascopet{ ascopet }
+        , m_overflow{ m_ascopet->m_overflow }
+        , m_buffer{ m_ascopet->localbuf_capacity(), m_ascopet->m_wake_watermark }
+    {
+        // a seed of its own so the random gaps of different threads aren't in lockstep, xorshift can't start at 0
+        m_rng = static_cast<std::uint32_t>(std::hash<std::thread::id>{}(std::this_thread::get_id())) | 1u;
+    }
+
+    LocalBuf* LocalBuf::attach(Ascopet* ascopet)
     {
+        return ascopet->add_localbuf(std::this_thread::get_id());
     }
 
-    Tracer::~Tracer()
-    {
-        if (m_buffer) {
-            m_buffer->add_record({
-                .name  = m_name,
-                .start = m_start,
-#if not defined(ASCOPET_DISABLE_RDTSC)
-                .end = __rdtsc(),
-#else
-                .end = static_cast<std::uint64_t>(Fallback::now().time_since_epoch().count()),
-#endif
-            });
+    void LocalBuf::detach()
+    {
+        m_ascopet->remove_localbuf(std::this_thread::get_id());
+    }
+
+    void LocalBuf::wake_worker() noexcept
+    {
+        m_ascopet->wake_worker();
+    }
+
+    void LocalBuf::refresh_sites(std::uint32_t epoch)
+    {
+        // the registry is read after the epoch, a change racing with this is picked up on the next call
+        auto configs = site_configs();
+
+        m_samplers.resize(configs.size());
+        for (auto id = 0u; id < configs.size(); ++id) {
+            auto& sampler   = m_samplers[id];
+            auto& sampling  = configs[id].sampling;
+            sampler.enabled = configs[id].enabled;
+            if (sampler.config.every != sampling.every or sampler.config.random != sampling.random) {
+                sampler.config    = sampling;
+                sampler.gap       = next_gap(sampler.config);
+                sampler.countdown = sampler.gap;
+            }
+        }
+        m_site_epoch = epoch;
+    }
+
+    bool LocalBuf::overflow(const NamedRecord& record) noexcept
+    {
+        switch (m_overflow) {
+        case Overflow::overwrite:
+            if (m_buffer.push_overwrite(record)) {
+                m_overwritten.store(m_overwritten.load(std::memory_order::relaxed) + 1, std::memory_order::relaxed);
+            }
+            return true;
+
+        case Overflow::block:
+            // the worker doesn't drain while paused, give up instead of waiting forever
+            m_ascopet->wake_worker();
+            while (m_ascopet->is_tracing()) {
+                std::this_thread::yield();
+                if (m_buffer.push(record) != Push::full) {
+                    return true;
+                }
+            }
+            [[fallthrough]];
+
+        case Overflow::drop: break;
         }
+
+        m_dropped.store(m_dropped.load(std::memory_order::relaxed) + 1, std::memory_order::relaxed);
+        return false;
     }
+
 }
 
 namespace ascopet
 {
     Ascopet::Ascopet(InitParam&& param)
         : m_processing{ param.immediately_start }
-        , m_worker{ std::jthread([this](std::stop_token st) { worker(st); }) }
         , m_record_capacity{ param.record_capacity }
         , m_buffer_capacity{ param.buffer_capacity }
+        , m_drain_threads{ std::max(param.drain_threads, std::size_t{ 1 }) }
+        , m_wake_watermark{ wake_watermark(param.buffer_capacity, param.wake_fill) }
+        , m_overflow{ param.overflow }
         , m_process_interval{ param.poll_interval }
+        , m_min_process_interval{ param.min_poll_interval }
 #if not defined(ASCOPET_DISABLE_RDTSC)
         , m_tsc_freq{ get_rdtsc_freq() }
 #else
         , m_tsc_freq{ Fallback::period::den }
 #endif
+        , m_windows{ std::move(param.windows) }
+        , m_window_ticks{ window_ticks(m_windows, m_tsc_freq) }
+        , m_window_buckets{ std::max(param.window_buckets, std::size_t{ 1 }) }
+        , m_call_tree{ param.call_tree }
+        , m_retire{ param.retire }
+        , m_retire_ttl{ param.retire_ttl }
+        , m_overhead{ calibrate_overhead<Timing::fast>() }
+        , m_serialized_overhead{ calibrate_overhead<Timing::serialized>() }
+        , m_subtract_overhead{ param.subtract_overhead }
+        , m_export{ std::make_unique<TraceExport>(m_tsc_freq) }
+        , m_recorder{ std::make_unique<Recorder>(m_tsc_freq, m_overhead, m_serialized_overhead) }
+        , m_live{ std::make_unique<LiveStats>() }
+        , m_pool{ std::make_unique<TaskPool>(m_drain_threads - 1) }
+        , m_worker{ std::jthread([this](std::stop_token st) { worker(st); }) }
     {
+        detail::s_enabled.store(param.immediately_start, std::memory_order::relaxed);
     }
 
     Ascopet::~Ascopet()
     {
+        detail::s_enabled.store(false, std::memory_order::relaxed);
         m_worker.request_stop();
 
         // NOTE: Even if the shared variable is atomic, it must be modified under the mutex in order to
@@ -246,28 +1003,114 @@ namespace ascopet
 
         m_worker.join();
         m_processing.store(false, std::memory_order::release);
+
+        m_export->stop();
+        m_recorder->stop();
+        m_live->stop();
     }
 
-    ascopet::Report Ascopet::report() const
+    ascopet::Report Ascopet::report(bool exact) const
     {
         auto report = ThreadMap<StrMap<TimingStat>>{};
         auto lock   = std::shared_lock{ m_data_mutex };
-        for (const auto& [id, records] : m_records) {
-            report.emplace(id, records.stat(m_tsc_freq));
+        for (const auto& [id, shard] : m_records) {
+            auto shard_lock = std::lock_guard{ shard->mutex };
+            report.emplace(id, shard->list.stat(m_tsc_freq, exact));
         }
         return report;
     }
 
-    ascopet::Report Ascopet::report_consume(bool remove_entries)
+    ascopet::Report Ascopet::report_consume(bool remove_entries, bool exact)
     {
         auto report = ThreadMap<StrMap<TimingStat>>{};
-        auto lock   = std::shared_lock{ m_data_mutex };
-        for (auto& [id, records] : m_records) {
-            report.emplace(id, records.stat(m_tsc_freq));
-            records.clear(remove_entries);
-        }
+
+        // removing the lists changes the map itself, clearing them only needs each list's lock
         if (remove_entries) {
+            auto lock = std::unique_lock{ m_data_mutex };
+            for (const auto& [id, shard] : m_records) {
+                report.emplace(id, shard->list.stat(m_tsc_freq, exact));
+            }
             m_records.clear();
+        } else {
+            auto lock = std::shared_lock{ m_data_mutex };
+            for (const auto& [id, shard] : m_records) {
+                auto shard_lock = std::lock_guard{ shard->mutex };
+                report.emplace(id, shard->list.stat(m_tsc_freq, exact));
+                shard->list.clear(false);
+            }
+        }
+
+        return report;
+    }
+
+    ascopet::QuantileReport Ascopet::report_quantiles(std::span<const double> quantiles) const
+    {
+        auto report = ThreadMap<StrMap<QuantileStat>>{};
+        auto lock   = std::shared_lock{ m_data_mutex };
+        for (const auto& [id, shard] : m_records) {
+            auto shard_lock = std::lock_guard{ shard->mutex };
+            report.emplace(id, shard->list.quantiles(m_tsc_freq, quantiles));
+        }
+        return report;
+    }
+
+    StrMap<TimingStat> Ascopet::aggregate_report() const
+    {
+        // below this many sites per task, handing them to the pool costs more than merging
+        constexpr auto min_sites_per_task = std::size_t{ 64 };
+
+        auto lock = std::shared_lock{ m_data_mutex };
+
+        auto bound = std::size_t{ 0 };
+        for (const auto& [_, shard] : m_records) {
+            auto shard_lock = std::lock_guard{ shard->mutex };
+            bound           = std::max(bound, shard->list.site_bound());
+        }
+
+        auto durations = std::vector<Summary>(bound);
+        auto intervals = std::vector<Summary>(bound);
+        auto windows   = std::vector<std::size_t>(bound);
+        auto skipped   = std::vector<std::uint64_t>(bound);
+
+        // each site is merged independently so the sites can be split across tasks without synchronization,
+        // a list only stays locked while its own range of sites is merged
+        auto merge_range = [&](std::size_t first, std::size_t last) {
+            for (const auto& [_, shard] : m_records) {
+                auto shard_lock = std::lock_guard{ shard->mutex };
+                for (auto id = first; id < last; ++id) {
+                    auto site_id = static_cast<SiteId>(id);
+                    windows[id] += shard->list.merge_summary(site_id, durations[id], intervals[id], skipped[id]);
+                }
+            }
+        };
+
+        auto tasks = std::min(m_drain_threads, bound / min_sites_per_task);
+        if (tasks <= 1) {
+            merge_range(0, bound);
+        } else {
+            auto chunk = (bound + tasks - 1) / tasks;
+            m_pool->run(tasks, [&](std::size_t task) {
+                auto first = task * chunk;
+                merge_range(first, std::min(first + chunk, bound));
+            });
+        }
+
+        auto scale  = kernel::TickScale{ m_tsc_freq };
+        auto report = StrMap<TimingStat>{};
+        for (auto id = 0u; id < bound; ++id) {
+            if (durations[id].stat.count() == 0) {
+                continue;
+            }
+            report.emplace(
+                site(id).name,
+                TimingStat{
+                    .duration    = summary_stat(durations[id], scale),
+                    .interval    = summary_stat(intervals[id], scale),
+                    .count       = durations[id].stat.count() + skipped[id],
+                    .sampled     = durations[id].stat.count(),
+                    .overwritten = durations[id].stat.count() - windows[id],
+                }
+            );
         }
         return report;
     }
@@ -276,20 +1119,211 @@ namespace ascopet
     {
         auto lock    = std::shared_lock{ m_data_mutex };
         auto records = ThreadMap<StrMap<RingBuf<Record>>>{};
-        for (const auto& [id, timing_list] : m_records) {
-            records.emplace(id, timing_list.records());
+        for (const auto& [id, shard] : m_records) {
+            auto shard_lock = std::lock_guard{ shard->mutex };
+            records.emplace(id, shard->list.records());
         }
         return records;
     }
 
-    void Ascopet::clear(bool remove_entries)
+    ascopet::Report Ascopet::report_since(ReportCursor& cursor) const
     {
-        auto lock = std::unique_lock{ m_data_mutex };
-        for (auto& [id, records] : m_records) {
-            records.clear(remove_entries);
+        auto report = ThreadMap<StrMap<TimingStat>>{};
+        auto lock   = std::shared_lock{ m_data_mutex };
+
+        // threads whose lists were removed won't come back with the same list
+        std::erase_if(cursor.m_threads, [&](const auto& pair) { return not m_records.contains(pair.first); });
+
+        for (const auto& [id, shard] : m_records) {
+            auto shard_lock = std::lock_guard{ shard->mutex };
+            if (auto stat = shard->list.stat_since(m_tsc_freq, cursor.m_threads[id]); not stat.empty()) {
+                report.emplace(id, std::move(stat));
+            }
+        }
+        return report;
+    }
+
+    ascopet::CallReport Ascopet::call_report() const
+    {
+        auto scale  = kernel::TickScale{ m_tsc_freq };
+        auto report = CallReport{};
+        auto lock   = std::shared_lock{ m_data_mutex };
+
+        for (const auto& [id, shard] : m_records) {
+            auto  shard_lock = std::lock_guard{ shard->mutex };
+            auto& paths      = report[id];
+            shard->list.calls().for_each_path([&](std::span<const SiteId> path, const CallTree::Node& node) {
+                auto names = std::vector<std::string_view>{};
+                for (auto site_id : path) {
+                    names.push_back(site(site_id).name);
+                }
+                paths.push_back({
+                    .path      = std::move(names),
+                    .count     = node.count,
+                    .inclusive = scale.to_stat(static_cast<double>(node.inclusive)),
+                    .self      = scale.to_stat(static_cast<double>(node.self)),
+                });
+            });
+        }
+        return report;
+    }
+
+    ascopet::CounterReport Ascopet::report_counters() const
+    {
+        auto report = CounterReport{};
+        auto lock   = std::shared_lock{ m_data_mutex };
+        for (const auto& [id, shard] : m_records) {
+            auto shard_lock = std::lock_guard{ shard->mutex };
+            report.emplace(id, shard->list.counter_stat(m_tsc_freq));
+        }
+        return report;
+    }
+
+    std::string Ascopet::folded_stacks() const
+    {
+        auto scale = kernel::TickScale{ m_tsc_freq };
+
+        // the same path on different threads is one line, sorted so the output is stable
+        auto stacks = std::map<std::string, std::uint64_t>{};
+        {
+            auto lock = std::shared_lock{ m_data_mutex };
+            for (const auto& [_, shard] : m_records) {
+                auto shard_lock = std::lock_guard{ shard->mutex };
+                shard->list.calls().for_each_path([&](std::span<const SiteId> path, const CallTree::Node& node) {
+                    auto stack = std::string{};
+                    for (auto site_id : path) {
+                        stack += stack.empty() ? "" : ";";
+                        stack += site(site_id).name;
+                    }
+                    stacks[std::move(stack)] += static_cast<std::uint64_t>(scale.to_duration(node.self).count());
+                });
+            }
+        }
+
+        auto folded = std::string{};
+        for (const auto& [stack, self] : stacks) {
+            if (self > 0) {
+                folded += stack;
+                folded += ' ';
+                folded += std::to_string(self);
+                folded += '\n';
+            }
+        }
+        return folded;
+    }
+
+    ascopet::Report Ascopet::report_window(Duration window) const
+    {
+        auto found = std::find(m_windows.begin(), m_windows.end(), window);
+        if (found == m_windows.end()) {
+            return {};
+        }
+
+        auto index  = static_cast<std::size_t>(found - m_windows.begin());
+        auto report = ThreadMap<StrMap<TimingStat>>{};
+        auto lock   = std::shared_lock{ m_data_mutex };
+        auto stamp  = now();
+
+        for (const auto& [id, shard] : m_records) {
+            auto shard_lock = std::lock_guard{ shard->mutex };
+            if (auto stat = shard->list.window_stat(m_tsc_freq, index, stamp); not stat.empty()) {
+                report.emplace(id, std::move(stat));
+            }
+        }
+        return report;
+    }
+
+    void Ascopet::start_export(int fd)
+    {
+        m_export->start(fd);
+    }
+
+    void Ascopet::stop_export()
+    {
+        m_export->stop();
+    }
+
+    bool Ascopet::start_recording(RecordParam param)
+    {
+        return m_recorder->start(std::move(param));
+    }
+
+    void Ascopet::stop_recording()
+    {
+        m_recorder->stop();
+    }
+
+    bool Ascopet::start_live(LiveParam param)
+    {
+        return m_live->start(std::move(param));
+    }
+
+    void Ascopet::stop_live()
+    {
+        m_live->stop();
+    }
+
+    ascopet::BufferReport Ascopet::buffer_report() const
+    {
+        auto slots = std::vector<std::shared_ptr<BufferSlot>>{};
+        {
+            auto lock = std::lock_guard{ m_buffers_mutex };
+            for (const auto& [_, slot] : m_buffers) {
+                slots.push_back(slot);
+            }
+        }
+
+        auto report = BufferReport{};
+        for (const auto& slot : slots) {
+            auto lock = std::lock_guard{ slot->mutex };
+            if (const auto* buffer = slot->buffer.get(); buffer) {
+                report.emplace(
+                    slot->id,
+                    BufferStat{
+                        .produced    = buffer->produced(),
+                        .drained     = buffer->drained(),
+                        .overwritten = buffer->overwritten(),
+                        .dropped     = buffer->dropped(),
+                        .capacity    = buffer->capacity(),
+                    }
+                );
+            }
+        }
+        return report;
+    }
+
+    ascopet::ThreadReport Ascopet::thread_report() const
+    {
+        auto report = ThreadReport{};
+        {
+            auto lock = std::shared_lock{ m_data_mutex };
+            for (const auto& [id, shard] : m_records) {
+                auto shard_lock = std::lock_guard{ shard->mutex };
+                report.emplace(id, shard->info);
+            }
         }
+
+        // NOTE: read after the lists, a thread the worker hasn't settled yet is still reported alive even if
+        // none of its records were drained, so waiting for no thread to be alive waits for all its records
+        auto lock = std::lock_guard{ m_buffers_mutex };
+        for (const auto& [slot, info] : m_exited) {
+            report.insert_or_assign(slot->id, info);
+        }
+        return report;
+    }
+
+    void Ascopet::clear(bool remove_entries)
+    {
         if (remove_entries) {
+            auto lock = std::unique_lock{ m_data_mutex };
             m_records.clear();
+            return;
+        }
+
+        auto lock = std::shared_lock{ m_data_mutex };
+        for (const auto& [id, shard] : m_records) {
+            auto shard_lock = std::lock_guard{ shard->mutex };
+            shard->list.clear(false);
         }
     }
 
@@ -300,12 +1334,14 @@ namespace ascopet
 
     void Ascopet::start_tracing()
     {
+        detail::s_enabled.store(true, std::memory_order::relaxed);
         m_processing.store(true, std::memory_order::release);
         m_processing.notify_one();
     }
 
     void Ascopet::pause_tracing()
     {
+        detail::s_enabled.store(false, std::memory_order::relaxed);
         m_processing.store(false, std::memory_order::release);
         m_processing.notify_one();
     }
@@ -318,29 +1354,27 @@ namespace ascopet
 
     std::size_t Ascopet::localbuf_capacity() const
     {
-        auto lock = std::shared_lock{ m_data_mutex };
         return m_buffer_capacity;
     }
 
     void Ascopet::resize_record_capacity(std::size_t capacity)
     {
+        // the unique lock also keeps the worker out of every list
         auto lock         = std::unique_lock{ m_data_mutex };
         m_record_capacity = capacity;
-        for (auto& [id, records] : m_records) {
-            records.resize(capacity);
+        for (auto& [id, shard] : m_records) {
+            shard->list.resize(capacity);
         }
     }
 
     ascopet::Duration Ascopet::process_interval() const
     {
-        auto lock = std::shared_lock{ m_data_mutex };
-        return m_process_interval;
+        return m_process_interval.load(std::memory_order::relaxed);
     }
 
     void Ascopet::set_process_interval(Duration interval)
     {
-        auto lock          = std::unique_lock{ m_data_mutex };
-        m_process_interval = interval;
+        m_process_interval.store(interval, std::memory_order::relaxed);
     }
 
     std::uint64_t Ascopet::tsc_freq() const
@@ -348,52 +1382,333 @@ namespace ascopet
         return m_tsc_freq;
     }
 
-    void Ascopet::add_localbuf(std::thread::id id, LocalBuf& buffer)
+    DrainStat Ascopet::drain_stat() const
     {
-        auto lock = std::unique_lock{ m_data_mutex };
-        m_buffers.emplace(id, &buffer);
+        return {
+            .polls    = m_drain_polls.load(std::memory_order::relaxed),
+            .records  = m_drain_records.load(std::memory_order::relaxed),
+            .busy     = Duration{ m_drain_busy.load(std::memory_order::relaxed) },
+            .max_busy = Duration{ m_drain_max.load(std::memory_order::relaxed) },
+            .wakeups  = m_drain_wakeups.load(std::memory_order::relaxed),
+            .interval = Duration{ m_drain_current.load(std::memory_order::relaxed) },
+        };
+    }
+
+    ascopet::Duration Ascopet::overhead(Timing timing) const
+    {
+        return kernel::TickScale{ m_tsc_freq }.to_duration(overhead_ticks(timing));
+    }
+
+    std::uint64_t Ascopet::overhead_ticks(Timing timing) const
+    {
+        return timing == Timing::serialized ? m_serialized_overhead : m_overhead;
+    }
+
+    LocalBuf* Ascopet::add_localbuf(std::thread::id id)
+    {
+        // the list of an exited thread with the same id must be out of the way before this one's first drain
+        settle_exited(id);
+        retire_now(id, std::nullopt);
+
+        auto buffer = std::make_unique<LocalBuf>(this);
+        auto ptr    = buffer.get();
+        auto slot   = std::make_shared<BufferSlot>(id, std::move(buffer), current_thread_info());
+
+        auto lock = std::lock_guard{ m_buffers_mutex };
+        m_buffers.insert_or_assign(id, std::move(slot));
+        return ptr;
     }
 
     void Ascopet::remove_localbuf(std::thread::id id)
     {
+        // the name may have been set after the first trace, and only this thread can still read it
+        auto info = current_thread_info();
+        {
+            auto lock = std::lock_guard{ m_buffers_mutex };
+            if (auto it = m_buffers.find(id); it != m_buffers.end()) {
+                m_exited.emplace_back(std::move(it->second), std::move(info));
+                m_buffers.erase(it);
+            }
+        }
+        wake_worker();
+    }
+
+    void Ascopet::settle_exited(std::optional<std::thread::id> id)
+    {
+        auto settle_lock = std::lock_guard{ m_settle_mutex };
+
+        auto matches = [&](const auto& pair) { return not id or pair.first->id == *id; };
+
+        // NOTE: the slots stay listed until they are retired, so thread_report() never misses a thread between
+        // its exit and the drain of what it left
+        auto exited = decltype(m_exited){};
+        {
+            auto lock = std::lock_guard{ m_buffers_mutex };
+            std::ranges::copy_if(m_exited, std::back_inserter(exited), matches);
+        }
+
+        // NOTE: the records of a short-lived thread may all still be in its buffer, it won't push any more so
+        // one drain is enough; a drain of the worker's last snapshot may still hold the slot, hence the lock
+        for (const auto& [slot, info] : exited) {
+            {
+                auto lock  = std::lock_guard{ slot->mutex };
+                slot->info = info;
+            }
+            drain(*slot);
+            {
+                auto lock = std::lock_guard{ slot->mutex };
+                slot->buffer.reset();
+            }
+            retire(slot->id, slot->info);
+        }
+
+        auto lock = std::lock_guard{ m_buffers_mutex };
+        auto kept = std::ranges::remove_if(m_exited, [&](const auto& pair) {
+            return std::ranges::any_of(exited, [&](const auto& done) { return done.first == pair.first; });
+        });
+        m_exited.erase(kept.begin(), kept.end());
+    }
+
+    void Ascopet::retire(std::thread::id id, ThreadInfo info)
+    {
+        auto now = RetireClock::now();
+        {
+            auto lock = std::shared_lock{ m_data_mutex };
+            auto it   = m_records.find(id);
+            if (it == m_records.end()) {
+                return;
+            }
+
+            auto& shard      = *it->second;
+            auto  shard_lock = std::lock_guard{ shard.mutex };
+            shard.info       = std::move(info);
+            shard.info.alive = false;
+            shard.retired    = now;
+        }
+
+        if (m_retire_ttl != Duration::max()) {
+            auto lock = std::lock_guard{ m_buffers_mutex };
+            m_retiring.emplace_back(now, id);
+        }
+    }
+
+    void Ascopet::retire_now(std::thread::id id, std::optional<RetireClock::time_point> when)
+    {
+        // most calls find nothing to retire, only then the map itself has to change
+        auto is_due = [&] {
+            auto it = m_records.find(id);
+            return it != m_records.end() and it->second->retired and (not when or it->second->retired == when);
+        };
+        {
+            auto lock = std::shared_lock{ m_data_mutex };
+            if (not is_due()) {
+                return;
+            }
+        }
+
         auto lock = std::unique_lock{ m_data_mutex };
-        m_buffers.erase(id);
+        if (not is_due()) {
+            return;
+        }
+
+        auto node = m_records.extract(id);
+        if (m_retire == Retire::merge) {
+            auto& retired = m_records[std::thread::id{}];
+            if (not retired) {
+                retired = make_shard(ThreadInfo{ .tid = 0, .name = "retired", .alive = false });
+            }
+            retired->list.absorb(node.mapped()->list);
+        }
+    }
+
+    void Ascopet::retire_expired()
+    {
+        auto now = RetireClock::now();
+        while (true) {
+            auto front = std::pair<RetireClock::time_point, std::thread::id>{};
+            {
+                auto lock = std::lock_guard{ m_buffers_mutex };
+                if (m_retiring.empty() or now - m_retiring.front().first < m_retire_ttl) {
+                    return;
+                }
+                front = m_retiring.front();
+                m_retiring.pop_front();
+            }
+            retire_now(front.second, front.first);
+        }
+    }
+
+    std::size_t Ascopet::drain(BufferSlot& slot)
+    {
+        // lock order: slot, then m_data_mutex, then the list
+        auto slot_lock = std::lock_guard{ slot.mutex };
+        if (slot.buffer == nullptr or slot.buffer->size() == 0) {
+            return 0;
+        }
+
+        auto consume_into = [&](TimingList& list) {
+            // the events are formatted and the records recorded as they are consumed, neither copies a buffer
+            auto batch = std::optional<TraceExport::Batch>{};
+            if (m_export->active()) {
+                batch.emplace(*m_export, slot.info);
+            }
+            auto recording = std::optional<Recorder::Batch>{};
+            if (m_recorder->active()) {
+                recording.emplace(*m_recorder, slot.info);
+            }
+
+            auto consumed = slot.buffer->consume([&](const NamedRecord& record) {
+                auto serialized = (record.flags & NamedRecord::serialized) != 0;
+                auto timing     = serialized ? Timing::serialized : Timing::fast;
+                auto overhead   = m_subtract_overhead ? overhead_ticks(timing) : 0;
+                list.push_back(record, overhead);
+                if (batch) {
+                    batch->add(record, overhead);
+                }
+                if (recording) {
+                    recording->add(record);    // raw, the overheads are in the file header
+                }
+            });
+            list.flush();    // before the list is unlocked, so reports never see unfolded records
+            return consumed;
+        };
+
+        {
+            auto lock = std::shared_lock{ m_data_mutex };
+            if (auto it = m_records.find(slot.id); it != m_records.end()) {
+                auto shard_lock = std::lock_guard{ it->second->mutex };
+                return consume_into(it->second->list);
+            }
+        }
+
+        // first records of this thread (or its list was removed), only then the map itself has to change
+        auto  lock  = std::unique_lock{ m_data_mutex };
+        auto& shard = m_records[slot.id];
+        if (not shard) {
+            shard = make_shard(slot.info);
+        }
+        return consume_into(shard->list);
+    }
+
+    std::unique_ptr<Ascopet::Shard> Ascopet::make_shard(ThreadInfo info) const
+    {
+        auto shard  = std::make_unique<Shard>(m_record_capacity, m_window_ticks, m_window_buckets, m_call_tree);
+        shard->info = std::move(info);
+        return shard;
+    }
+
+    void Ascopet::wake_worker()
+    {
+        // NOTE: The flag must be set under the mutex, otherwise the worker may miss it between checking it
+        // and going to sleep. This is only taken on a watermark crossing so the lock is rarely contended.
+        {
+            auto lock = std::lock_guard{ m_cond_mutex };
+            m_wake.store(true, std::memory_order::relaxed);
+        }
+        m_cv.notify_one();
     }
 
     void Ascopet::worker(std::stop_token st)
     {
+        // below this many buffers per task, handing them to the pool costs more than draining
+        constexpr auto min_buffers_per_task = std::size_t{ 8 };
+
+        // the interval halves when the fullest buffer was at least this full on the last drain and doubles
+        // when it was below the lower one
+        constexpr auto shrink_fill = 0.5;
+        constexpr auto grow_fill   = 0.125;
+
         m_processing.wait(false);
 
         using Clock = std::chrono::steady_clock;
 
+        using Drained = std::pair<std::uint64_t, std::size_t>;    // total, and the most from a single buffer
+
+        auto slots    = std::vector<std::shared_ptr<BufferSlot>>{};
+        auto interval = process_interval();
+
         while (not st.stop_requested()) {
-            auto elapsed = [this] {
+            auto [spent, peak] = [&] {
                 auto start = Clock::now();
-                auto lock  = std::unique_lock{ m_data_mutex };
 
-                for (auto [id, buffer] : m_buffers) {
-                    auto& records = buffer->swap();
-
-                    auto it = m_records.find(id);
-                    if (it == m_records.end()) {
-                        auto [new_it, _] = m_records.emplace(id, m_record_capacity);
-                        it               = new_it;
+                // snapshot the registry so threads can register and exit while the buffers are drained
+                slots.clear();
+                {
+                    auto lock = std::lock_guard{ m_buffers_mutex };
+                    for (const auto& [_, slot] : m_buffers) {
+                        slots.push_back(slot);
                     }
+                }
 
-                    for (auto i = 0u; i < records.size(); ++i) {
-                        auto& record = records[i];
-                        it->second.push_back(record);
+                auto drain_range = [&](std::size_t first, std::size_t last) {
+                    auto drained = Drained{ 0, 0 };
+                    for (auto i = first; i < last; ++i) {
+                        auto count      = drain(*slots[i]);
+                        drained.first  += count;
+                        drained.second  = std::max(drained.second, count);
                     }
+                    return drained;
+                };
+
+                auto [drained, fullest] = Drained{ 0, 0 };
+                auto tasks              = std::min(m_drain_threads, slots.size() / min_buffers_per_task);
+                if (tasks <= 1) {
+                    std::tie(drained, fullest) = drain_range(0, slots.size());
+                } else {
+                    auto chunk   = (slots.size() + tasks - 1) / tasks;
+                    auto results = std::vector<Drained>(tasks);
+                    m_pool->run(tasks, [&](std::size_t task) {
+                        auto first    = task * chunk;
+                        results[task] = drain_range(first, std::min(first + chunk, slots.size()));
+                    });
+                    for (auto [count, most] : results) {
+                        drained += count;
+                        fullest  = std::max(fullest, most);
+                    }
+                }
 
-                    records.clear();
+                auto elapsed = Clock::now() - start;
+                auto busy    = std::chrono::duration_cast<Duration>(elapsed).count();
+
+                // only the worker writes these
+                m_drain_polls.fetch_add(1, std::memory_order::relaxed);
+                m_drain_records.fetch_add(drained, std::memory_order::relaxed);
+                m_drain_busy.fetch_add(busy, std::memory_order::relaxed);
+                if (busy > m_drain_max.load(std::memory_order::relaxed)) {
+                    m_drain_max.store(busy, std::memory_order::relaxed);
                 }
 
-                return Clock::now() - start;
+                return std::pair{ elapsed, fullest };
             }();
 
-            {
+            settle_exited(std::nullopt);
+            retire_expired();
+
+            // NOTE: the snapshot is taken like any other report, so it only holds each list's lock briefly
+            if (m_live->active() and m_live->due(Clock::now())) {
+                m_live->publish(aggregate_report(), Clock::now());
+            }
+
+            auto fill         = static_cast<double>(peak) / static_cast<double>(std::bit_ceil(m_buffer_capacity));
+            auto max_interval = process_interval();
+            auto min_interval = std::min(m_min_process_interval, max_interval);
+
+            if (fill >= shrink_fill) {
+                interval /= 2;
+            } else if (fill < grow_fill) {
+                interval *= 2;
+            }
+            interval = std::clamp(interval, min_interval, max_interval);
+            m_drain_current.store(interval.count(), std::memory_order::relaxed);
+
+            auto woken = [&] {
                 auto lock = std::unique_lock{ m_cond_mutex };
-                m_cv.wait_for(lock, m_process_interval - elapsed);
+                return m_cv.wait_for(lock, interval - spent, [&] {
+                    return m_wake.exchange(false, std::memory_order::relaxed) or st.stop_requested();
+                });
+            }();
+            if (woken and not st.stop_requested()) {
+                m_drain_wakeups.fetch_add(1, std::memory_order::relaxed);
             }
 
             m_processing.wait(false);
@@ -419,18 +1734,43 @@ namespace ascopet
         return Ascopet::s_instance.get();
     }
 
-    Tracer trace(std::source_location location)
+    namespace detail
     {
-        auto name = location.function_name();
-        return trace(name);
-    }
+        LocalBuf* acquire_localbuf()
+        {
+            auto ptr = instance();
+            if (ptr == nullptr or t_retired) {
+                return nullptr;
+            }
 
-    Tracer trace(std::string_view name)
-    {
-        if (auto ptr = instance(); ptr != nullptr and ptr->is_tracing()) {
-            static thread_local auto buffer = LocalBuf{ ptr };
-            return { &buffer, name };
+            static thread_local auto buffer = ThreadBuffer{ LocalBuf::attach(ptr) };
+            s_localbuf                      = buffer.buffer;
+            return s_localbuf;
+        }
+
+        SiteId lookup_site(std::string_view name)
+        {
+            static thread_local auto cache = std::unordered_map<LiteralKey, SiteId, LiteralKeyHash>{};
+
+            auto [it, inserted] = cache.try_emplace({ name.data(), name.size() }, 0);
+            if (inserted) {
+                it->second = register_site(name, {});
+            }
+
+            s_name_cache = { name.data(), name.size(), it->second };
+            return it->second;
+        }
+
+        SiteId lookup_site(std::source_location location)
+        {
+            static thread_local auto cache = std::unordered_map<LiteralKey, SiteId, LiteralKeyHash>{};
+
+            // NOTE: function names are unique per function, so the line can stand in for the length here
+            auto [it, inserted] = cache.try_emplace({ location.function_name(), location.line() }, 0);
+            if (inserted) {
+                it->second = register_site(location);
+            }
+            return it->second;
         }
-        return { nullptr, name };
     }
 }
@@ -0,0 +1,267 @@
+#include "export.hpp"
+#include "kernel.hpp"
+
+#include "ascopet/site.hpp"
+
+#include <cerrno>
+#include <charconv>
+#include <cstdio>
+#include <string>
+
+#if defined(_WIN32)
+#    include <io.h>
+#else
+#    include <unistd.h>
+#endif
+
+namespace
+{
+    // every track belongs to the same process, its real pid wouldn't tell anything more
+    constexpr auto pid = 1;
+
+    // appends `str` as a JSON string
+    void append_quoted(std::string& out, std::string_view str)
+    {
+        out += '"';
+        for (auto c : str) {
+            if (c == '"' or c == '\\') {
+                out += '\\';
+                out += c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                char buf[8];
+                std::snprintf(buf, sizeof(buf), "\\u%04x", static_cast<unsigned>(c));
+                out += buf;
+            } else {
+                out += c;
+            }
+        }
+        out += '"';
+    }
+
+    // false if the descriptor can't be written to anymore
+    bool write_all(int fd, std::string_view data)
+    {
+        while (not data.empty()) {
+#if defined(_WIN32)
+            auto written = ::_write(fd, data.data(), static_cast<unsigned>(data.size()));
+#else
+            auto written = ::write(fd, data.data(), data.size());
+#endif
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            data.remove_prefix(static_cast<std::size_t>(written));
+        }
+        return true;
+    }
+}
+
+namespace ascopet
+{
+    TraceExport::Batch::Batch(TraceExport& exporter, const ThreadInfo& thread)
+        : m_export{ exporter }
+        , m_lock{ exporter.m_mutex }
+        , m_tid{ thread.tid }
+    {
+        if (m_export.m_fd < 0) {
+            return;
+        }
+
+        // the track is named again if the thread was renamed, or if its OS id was reused by another one
+        auto name = thread.name.empty() ? "thread " + std::to_string(m_tid) : thread.name;
+        if (auto [it, inserted] = m_export.m_tracks.try_emplace(m_tid, name); inserted or it->second != name) {
+            it->second = name;
+
+            char buf[96];
+            std::snprintf(
+                buf,
+                sizeof(buf),
+                R"({"name":"thread_name","ph":"M","pid":%d,"tid":%llu,"args":{"name":)",
+                pid,
+                static_cast<unsigned long long>(m_tid)
+            );
+            m_export.event_prefix();
+            m_export.m_staged += buf;
+            append_quoted(m_export.m_staged, name);
+            m_export.m_staged += "}}";
+        }
+    }
+
+    TraceExport::Batch::~Batch()
+    {
+        if (m_export.m_fd >= 0) {
+            m_export.flush();
+        }
+    }
+
+    void TraceExport::Batch::add(const NamedRecord& record, std::uint64_t overhead)
+    {
+        if (m_export.m_fd < 0) {
+            return;
+        }
+
+        m_export.event_prefix();
+        m_export.m_staged += R"({"name":)";
+        m_export.append_site(record.site);
+
+        char buf[96];
+        switch (record.kind()) {
+        // NOTE: a Span may end after scopes its thread opened later, it couldn't nest on the thread's track, so
+        // it is a pair of async events with an id of its own, which the viewers draw on a separate track
+        case NamedRecord::scope: {
+            auto duration = kernel::delta(record.start, record.end, overhead);
+            if ((record.flags & NamedRecord::detached) != 0) {
+                auto id = m_export.m_next_span++;
+                std::snprintf(
+                    buf,
+                    sizeof(buf),
+                    R"(,"pid":%d,"tid":%llu,"id":%llu})",
+                    pid,
+                    static_cast<unsigned long long>(m_tid),
+                    static_cast<unsigned long long>(id)
+                );
+                m_export.m_staged += R"(,"cat":"span","ph":"b","ts":)";
+                m_export.append_number(static_cast<double>(record.start) * m_export.m_us_per_tick);
+                m_export.m_staged += buf;
+
+                m_export.event_prefix();
+                m_export.m_staged += R"({"name":)";
+                m_export.append_site(record.site);
+                m_export.m_staged += R"(,"cat":"span","ph":"e","ts":)";
+                m_export.append_number(static_cast<double>(record.start + duration) * m_export.m_us_per_tick);
+                break;
+            }
+            m_export.m_staged += R"(,"ph":"X","ts":)";
+            m_export.append_number(static_cast<double>(record.start) * m_export.m_us_per_tick);
+            m_export.m_staged += R"(,"dur":)";
+            m_export.append_number(static_cast<double>(duration) * m_export.m_us_per_tick);
+            std::snprintf(buf, sizeof(buf), R"(,"pid":%d,"tid":%llu})", pid, static_cast<unsigned long long>(m_tid));
+        } break;
+
+        // a gauge is drawn as a counter track of the process, the increments of a counter as instant events
+        case NamedRecord::gauge: {
+            m_export.m_staged += R"(,"ph":"C","ts":)";
+            m_export.append_number(static_cast<double>(record.start) * m_export.m_us_per_tick);
+            std::snprintf(
+                buf,
+                sizeof(buf),
+                R"(,"pid":%d,"tid":%llu,"args":{"value":%llu}})",
+                pid,
+                static_cast<unsigned long long>(m_tid),
+                static_cast<unsigned long long>(record.end)
+            );
+        } break;
+
+        case NamedRecord::counter: {
+            m_export.m_staged += R"(,"ph":"i","s":"t","ts":)";
+            m_export.append_number(static_cast<double>(record.start) * m_export.m_us_per_tick);
+            std::snprintf(
+                buf,
+                sizeof(buf),
+                R"(,"pid":%d,"tid":%llu,"args":{"amount":%llu}})",
+                pid,
+                static_cast<unsigned long long>(m_tid),
+                static_cast<unsigned long long>(record.end)
+            );
+        } break;
+
+        default: {
+            m_export.m_staged += R"(,"ph":"i","s":"t","ts":)";
+            m_export.append_number(static_cast<double>(record.start) * m_export.m_us_per_tick);
+            std::snprintf(buf, sizeof(buf), R"(,"pid":%d,"tid":%llu})", pid, static_cast<unsigned long long>(m_tid));
+        } break;
+        }
+        m_export.m_staged += buf;
+
+        if (m_export.m_staged.size() >= flush_size) {
+            m_export.flush();
+        }
+    }
+
+    TraceExport::TraceExport(std::uint64_t freq)
+        : m_us_per_tick{ 1e6 / static_cast<double>(freq) }
+    {
+        m_staged.reserve(flush_size + 1024);
+    }
+
+    void TraceExport::start(int fd)
+    {
+        stop();
+
+        auto lock = std::lock_guard{ m_mutex };
+        if (fd < 0) {
+            return;
+        }
+
+        m_fd        = fd;
+        m_first     = true;
+        m_next_span = 0;
+        m_tracks.clear();
+
+        m_staged += "[\n";
+        event_prefix();
+
+        char buf[128];
+        std::snprintf(buf, sizeof(buf), R"({"name":"process_name","ph":"M","pid":%d,"args":{"name":"ascopet"}})", pid);
+        m_staged += buf;
+        flush();
+
+        m_active.store(m_fd >= 0, std::memory_order::relaxed);
+    }
+
+    void TraceExport::stop()
+    {
+        auto lock = std::lock_guard{ m_mutex };
+        if (m_fd < 0) {
+            return;
+        }
+
+        m_staged += "\n]\n";
+        flush();
+
+        m_fd = -1;
+        m_active.store(false, std::memory_order::relaxed);
+    }
+
+    void TraceExport::event_prefix()
+    {
+        if (not m_first) {
+            m_staged += ",\n";
+        }
+        m_first = false;
+    }
+
+    void TraceExport::append_site(SiteId id)
+    {
+        // escaped once per site, looking up the registry for every record would take its lock
+        if (id >= m_names.size()) {
+            m_names.resize(id + 1);
+        }
+
+        auto& escaped = m_names[id];
+        if (escaped.empty()) {
+            append_quoted(escaped, site(id).name);
+        }
+        m_staged += escaped;
+    }
+
+    void TraceExport::append_number(double value)
+    {
+        char buf[32];
+        auto [end, _] = std::to_chars(buf, buf + sizeof(buf), value, std::chars_format::fixed, 3);
+        m_staged.append(buf, end);
+    }
+
+    void TraceExport::flush()
+    {
+        // a descriptor that can't be written to anymore ends the export, there is nobody to report to
+        if (not write_all(m_fd, m_staged)) {
+            m_fd = -1;
+            m_active.store(false, std::memory_order::relaxed);
+        }
+        m_staged.clear();
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "ascopet/common.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace ascopet
+{
+    // Streams records as Chrome trace events (the JSON array format, also read by ui.perfetto.dev) to a file
+    // descriptor. Each scope becomes a complete ("X") event on the track of its thread, and each Span a pair of
+    // async ("b"/"e") events, formatted straight from the drained buffer into a small staging string that is
+    // written out whenever it fills up.
+    class TraceExport
+    {
+    public:
+        // the events of one thread's drain, the export stays locked while it is alive
+        class Batch
+        {
+        public:
+            Batch(TraceExport& exporter, const ThreadInfo& thread);
+            ~Batch();
+
+            Batch(Batch&&)            = delete;
+            Batch& operator=(Batch&&) = delete;
+
+            // does nothing if the export was stopped before the batch was created
+            void add(const NamedRecord& record, std::uint64_t overhead);
+
+        private:
+            TraceExport&                 m_export;
+            std::unique_lock<std::mutex> m_lock;
+            std::uint64_t                m_tid;
+        };
+
+        TraceExport(std::uint64_t freq);
+
+        // starts a new trace on `fd`, closing the one in progress if any
+        void start(int fd);
+
+        // closes the trace so it is valid JSON, the descriptor itself is left open
+        void stop();
+
+        bool active() const { return m_active.load(std::memory_order::relaxed); }
+
+    private:
+        // flushed to the descriptor once this much is staged
+        static constexpr std::size_t flush_size = std::size_t{ 64 } * 1024;
+
+        void event_prefix();
+        void append_site(SiteId id);
+        void append_number(double value);
+        void flush();
+
+        std::mutex        m_mutex;
+        std::atomic<bool> m_active = false;
+
+        int           m_fd        = -1;
+        bool          m_first     = true;    // no event was written yet, so no separator is needed
+        std::uint64_t m_next_span = 0;       // id of the async events of the next Span
+        double        m_us_per_tick;
+        std::string   m_staged;
+
+        std::unordered_map<std::uint64_t, std::string> m_tracks;    // name given to the track of each OS thread id
+        std::vector<std::string>                       m_names;     // quoted and escaped, indexed by SiteId
+    };
+}
@@ -0,0 +1,145 @@
+#include "kernel.hpp"
+
+#include <algorithm>
+
+#if defined(__x86_64__) and (defined(__GNUC__) or defined(__clang__))
+#define ASCOPET_KERNEL_AVX2
+#include <immintrin.h>
+#endif
+
+namespace ascopet::kernel
+{
+    TickScale::TickScale(std::uint64_t freq)
+#if defined(__SIZEOF_INT128__)
+        : m_mult{ static_cast<std::uint64_t>((static_cast<Uint128>(Duration::period::den) << 32) / freq) }
+#else
+        : m_mult{ 0 }
+#endif
+        , m_ns_per_tick{ static_cast<double>(Duration::period::den) / static_cast<double>(freq) }
+    {
+    }
+
+    DeltaStat delta_stat_scalar(
+        const std::uint64_t* a,
+        const std::uint64_t* b,
+        std::size_t          n,
+        std::uint64_t        offset,
+        double               pivot
+    )
+    {
+        auto stat = DeltaStat{ .count = n };
+        for (auto i = 0u; i < n; ++i) {
+            auto x = delta(a[i], b[i], offset);
+            auto y = static_cast<double>(x) - pivot;
+
+            stat.sum    += x;
+            stat.sum_dy += y;
+            stat.sum_sq += y * y;
+            stat.min     = std::min(stat.min, x);
+            stat.max     = std::max(stat.max, x);
+        }
+        return stat;
+    }
+
+#if defined(ASCOPET_KERNEL_AVX2)
+    __attribute__((target("avx2"))) DeltaStat delta_stat_avx2(
+        const std::uint64_t* a,
+        const std::uint64_t* b,
+        std::size_t          n,
+        std::uint64_t        offset,
+        double               pivot
+    )
+    {
+        // NOTE: avx2 has no u64 -> double conversion, but every value is below 2^52 after clamping, so its bits
+        // can be put in the mantissa of 2^52 directly and 2^52 subtracted afterwards
+        const auto magic_bits = _mm256_set1_epi64x(0x4330000000000000);
+        const auto magic      = _mm256_set1_pd(4503599627370496.0);    // 2^52
+
+        const auto zero     = _mm256_setzero_si256();
+        const auto offset_v = _mm256_set1_epi64x(static_cast<long long>(offset));
+        const auto max_v    = _mm256_set1_epi64x(static_cast<long long>(max_delta));
+        const auto pivot_v  = _mm256_set1_pd(pivot);
+
+        auto sum    = _mm256_setzero_si256();
+        auto sum_dy = _mm256_setzero_pd();
+        auto sum_sq = _mm256_setzero_pd();
+        auto min    = _mm256_set1_pd(static_cast<double>(max_delta));
+        auto max    = _mm256_setzero_pd();
+
+        auto i = std::size_t{ 0 };
+        for (; i + 4 <= n; i += 4) {
+            auto va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+            auto vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+
+            // same as delta(): negative -> 0, subtract the offset saturating at 0, clamp to max_delta
+            auto d = _mm256_sub_epi64(vb, va);
+            d      = _mm256_andnot_si256(_mm256_cmpgt_epi64(zero, d), d);
+            auto x = _mm256_and_si256(_mm256_cmpgt_epi64(d, offset_v), _mm256_sub_epi64(d, offset_v));
+            x      = _mm256_blendv_epi8(x, max_v, _mm256_cmpgt_epi64(x, max_v));
+
+            auto xd = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(x, magic_bits)), magic);
+            auto y  = _mm256_sub_pd(xd, pivot_v);
+
+            sum    = _mm256_add_epi64(sum, x);
+            sum_dy = _mm256_add_pd(sum_dy, y);
+            sum_sq = _mm256_add_pd(sum_sq, _mm256_mul_pd(y, y));
+            min    = _mm256_min_pd(min, xd);
+            max    = _mm256_max_pd(max, xd);
+        }
+
+        alignas(32) std::uint64_t sums[4];
+        alignas(32) double        lanes[4][4];
+
+        _mm256_store_si256(reinterpret_cast<__m256i*>(sums), sum);
+        _mm256_store_pd(lanes[0], sum_dy);
+        _mm256_store_pd(lanes[1], sum_sq);
+        _mm256_store_pd(lanes[2], min);
+        _mm256_store_pd(lanes[3], max);
+
+        auto stat = delta_stat_scalar(a + i, b + i, n - i, offset, pivot);
+        for (auto lane = 0u; lane < 4 and i > 0; ++lane) {
+            stat.sum    += sums[lane];
+            stat.sum_dy += lanes[0][lane];
+            stat.sum_sq += lanes[1][lane];
+            stat.min     = std::min(stat.min, static_cast<std::uint64_t>(lanes[2][lane]));
+            stat.max     = std::max(stat.max, static_cast<std::uint64_t>(lanes[3][lane]));
+        }
+        stat.count = n;
+
+        return stat;
+    }
+
+    bool has_avx2()
+    {
+        static const auto supported = __builtin_cpu_supports("avx2") != 0;
+        return supported;
+    }
+#else
+    DeltaStat delta_stat_avx2(
+        const std::uint64_t* a,
+        const std::uint64_t* b,
+        std::size_t          n,
+        std::uint64_t        offset,
+        double               pivot
+    )
+    {
+        return delta_stat_scalar(a, b, n, offset, pivot);
+    }
+
+    bool has_avx2()
+    {
+        return false;
+    }
+#endif
+
+    DeltaStat delta_stat(
+        const std::uint64_t* a,
+        const std::uint64_t* b,
+        std::size_t          n,
+        std::uint64_t        offset,
+        double               pivot
+    )
+    {
+        return has_avx2() ? delta_stat_avx2(a, b, n, offset, pivot) : delta_stat_scalar(a, b, n, offset, pivot);
+    }
+}
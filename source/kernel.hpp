@@ -0,0 +1,103 @@
+#pragma once
+
+#include "ascopet/ascopet.hpp"
+
+#include <cstdint>
+#include <limits>
+
+namespace ascopet::kernel
+{
+#if defined(__SIZEOF_INT128__)
+    __extension__ typedef unsigned __int128 Uint128;
+#endif
+
+    // Tick to nanosecond conversion without a division per value. `ticks * 1e9 / freq` overflows 64 bits once a
+    // value exceeds ~7s at 2.5 GHz, here the product with the 32.32 fixed point reciprocal is done in 128 bits.
+    class TickScale
+    {
+    public:
+        explicit TickScale(std::uint64_t freq);
+
+        Duration to_duration(std::uint64_t ticks) const
+        {
+#if defined(__SIZEOF_INT128__)
+            auto ns = (static_cast<Uint128>(ticks) * m_mult) >> 32;
+            return Duration{ static_cast<Duration::rep>(ns) };
+#else
+            return Duration{ static_cast<Duration::rep>(static_cast<double>(ticks) * m_ns_per_tick) };
+#endif
+        }
+
+        StatDuration to_stat(double ticks) const { return StatDuration{ ticks * m_ns_per_tick }; }
+
+    private:
+        std::uint64_t m_mult;    // ns per tick << 32
+        double        m_ns_per_tick;
+    };
+
+    // values are clamped to this so they convert to double exactly
+    inline constexpr std::uint64_t max_delta = (std::uint64_t{ 1 } << 52) - 1;
+
+    // moments of x[i] = min(max(b[i] - a[i] - offset, 0), max_delta) around `pivot`; picking a pivot close to
+    // the mean keeps the sum of squares from cancelling out
+    struct DeltaStat
+    {
+        std::uint64_t count  = 0;
+        std::uint64_t sum    = 0;
+        double        sum_dy = 0.0;    // sum of x - pivot
+        double        sum_sq = 0.0;    // sum of (x - pivot)^2
+        std::uint64_t min    = std::numeric_limits<std::uint64_t>::max();
+        std::uint64_t max    = 0;
+    };
+
+    // one pass over n pairs, dispatched at runtime to the widest implementation the cpu supports
+    DeltaStat delta_stat(
+        const std::uint64_t* a,
+        const std::uint64_t* b,
+        std::size_t          n,
+        std::uint64_t        offset,
+        double               pivot
+    );
+
+    DeltaStat delta_stat_scalar(
+        const std::uint64_t* a,
+        const std::uint64_t* b,
+        std::size_t          n,
+        std::uint64_t        offset,
+        double               pivot
+    );
+
+    // falls back to the scalar implementation where avx2 isn't available
+    DeltaStat delta_stat_avx2(
+        const std::uint64_t* a,
+        const std::uint64_t* b,
+        std::size_t          n,
+        std::uint64_t        offset,
+        double               pivot
+    );
+
+    // whether delta_stat uses the avx2 implementation
+    bool has_avx2();
+
+    inline std::uint64_t delta(std::uint64_t a, std::uint64_t b, std::uint64_t offset)
+    {
+        auto d = b - a;
+        if (static_cast<std::int64_t>(d) < 0) {    // b < a, the tsc of different cores may disagree a bit
+            return 0;
+        }
+        return d > offset ? std::min(d - offset, max_delta) : 0;
+    }
+
+    // exact running stat of the same values, the moments are converted around their own mean
+    inline RunningStat to_running_stat(const DeltaStat& stat, double pivot)
+    {
+        if (stat.count == 0) {
+            return {};
+        }
+        auto n    = static_cast<double>(stat.count);
+        auto dy   = stat.sum_dy / n;
+        auto m2   = std::max(stat.sum_sq - stat.sum_dy * dy, 0.0);
+        auto mean = pivot + dy;
+        return RunningStat{ stat.count, stat.sum, stat.min, stat.max, mean, m2 };
+    }
+}
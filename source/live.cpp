@@ -0,0 +1,137 @@
+#include "live.hpp"
+
+#if not defined(_WIN32)
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+namespace ascopet
+{
+    LiveStats::~LiveStats()
+    {
+        stop();
+    }
+
+    bool LiveStats::start(LiveParam param)
+    {
+        stop();
+
+#if defined(_WIN32)
+        (void)param;
+        return false;
+#else
+        auto lock = std::lock_guard{ m_mutex };
+
+        m_param             = std::move(param);
+        m_param.max_entries = std::max(m_param.max_entries, std::size_t{ 1 });
+        m_param.interval    = std::max(m_param.interval, Duration{ std::chrono::milliseconds{ 10 } });
+
+        auto pid = static_cast<std::uint64_t>(::getpid());
+        m_name   = live::segment_name(pid);
+        m_size   = live::segment_size(m_param.max_entries);
+
+        // NOTE: a segment left behind by a crashed process with the same pid is simply taken over
+        auto fd = ::shm_open(m_name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            return false;
+        }
+
+        auto sized = ::ftruncate(fd, static_cast<off_t>(m_size)) == 0;
+        auto map   = sized ? ::mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+        ::close(fd);
+        if (map == MAP_FAILED) {
+            ::shm_unlink(m_name.c_str());
+            return false;
+        }
+        m_map = static_cast<std::byte*>(map);
+
+        // the segment is zero-filled, so until the magic is written it reads as not being a segment at all
+        auto* header     = new (m_map) live::Header{};
+        header->version  = live::version;
+        header->capacity = static_cast<std::uint32_t>(m_param.max_entries);
+        header->pid      = pid;
+        header->interval = static_cast<std::uint64_t>(m_param.interval.count());
+        std::atomic_thread_fence(std::memory_order::release);
+        std::copy_n(live::magic, sizeof(live::magic), header->magic);
+
+        m_staged.reserve(m_param.max_entries);
+        m_next = Clock::now();
+        m_active.store(true, std::memory_order::relaxed);
+        return true;
+#endif
+    }
+
+    void LiveStats::stop()
+    {
+        auto lock = std::lock_guard{ m_mutex };
+        close_segment();
+        m_active.store(false, std::memory_order::relaxed);
+    }
+
+    void LiveStats::close_segment()
+    {
+#if not defined(_WIN32)
+        if (m_map != nullptr) {
+            ::munmap(m_map, m_size);
+            ::shm_unlink(m_name.c_str());
+            m_map = nullptr;
+        }
+#endif
+    }
+
+    bool LiveStats::due(Clock::time_point now)
+    {
+        auto lock = std::lock_guard{ m_mutex };
+        return m_map != nullptr and now >= m_next;
+    }
+
+    void LiveStats::publish(const StrMap<TimingStat>& stats, Clock::time_point now)
+    {
+        auto lock = std::lock_guard{ m_mutex };
+        if (m_map == nullptr) {
+            return;
+        }
+        m_next = now + m_param.interval;
+
+        m_staged.clear();
+        for (const auto& [name, stat] : stats) {
+            auto entry = live::Entry{
+                .name    = {},
+                .count   = stat.count,
+                .sampled = stat.sampled,
+                .total   = stat.duration.mean.count() * static_cast<double>(stat.count),
+                .mean    = stat.duration.mean.count(),
+                .median  = stat.duration.median.count(),
+                .p99     = stat.duration.p99.count(),
+                .max     = stat.duration.max.count(),
+            };
+            std::memcpy(entry.name, name.data(), std::min(name.size(), live::name_length - 1));
+            m_staged.push_back(entry);
+        }
+
+        // only the entries with the most total time make it into a full segment
+        auto by_total = [](const live::Entry& a, const live::Entry& b) { return a.total > b.total; };
+        auto count    = std::min(m_staged.size(), m_param.max_entries);
+        auto last     = m_staged.begin() + static_cast<std::ptrdiff_t>(count);
+        std::partial_sort(m_staged.begin(), last, m_staged.end(), by_total);
+
+        auto  published = std::chrono::system_clock::now().time_since_epoch();
+        auto* header    = reinterpret_cast<live::Header*>(m_map);
+        auto  sequence  = header->sequence.load(std::memory_order::relaxed);
+
+        header->sequence.store(sequence + 1, std::memory_order::relaxed);
+        std::atomic_thread_fence(std::memory_order::release);
+
+        header->published = static_cast<std::uint64_t>(std::chrono::duration_cast<Duration>(published).count());
+        header->count     = count;
+        header->omitted   = m_staged.size() - count;
+        std::memcpy(m_map + sizeof(live::Header), m_staged.data(), count * sizeof(live::Entry));
+
+        header->sequence.store(sequence + 2, std::memory_order::release);
+    }
+}
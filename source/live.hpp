@@ -0,0 +1,56 @@
+#pragma once
+
+#include "ascopet/ascopet.hpp"
+#include "ascopet/live.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ascopet
+{
+    // Publishes snapshots of the aggregated stats into a POSIX shared-memory segment (see live.hpp for the
+    // layout) for other processes to read, like ascopet-top. Only the worker publishes: it builds a snapshot
+    // off the segment, then copies it in under the seqlock, so the segment is only inconsistent for a memcpy
+    // of at most `max_entries` entries.
+    class LiveStats
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        LiveStats() = default;
+        ~LiveStats();
+
+        LiveStats(LiveStats&&)            = delete;
+        LiveStats& operator=(LiveStats&&) = delete;
+
+        // creates the segment of this process, replacing the one in progress if any; false if it can't be
+        bool start(LiveParam param);
+        void stop();
+
+        bool active() const { return m_active.load(std::memory_order::relaxed); }
+
+        // whether a snapshot is due, checked by the worker before it computes one
+        bool due(Clock::time_point now);
+
+        // does nothing if stopped since due() said otherwise
+        void publish(const StrMap<TimingStat>& stats, Clock::time_point now);
+
+    private:
+        void close_segment();
+
+        std::mutex        m_mutex;
+        std::atomic<bool> m_active = false;
+
+        LiveParam         m_param;
+        std::string       m_name;
+        std::byte*        m_map  = nullptr;
+        std::size_t       m_size = 0;
+        Clock::time_point m_next = {};    // of the next snapshot
+
+        std::vector<live::Entry> m_staged;    // the snapshot being built, kept for its capacity
+    };
+}
@@ -0,0 +1,66 @@
+#include "pool.hpp"
+
+#include <algorithm>
+
+namespace ascopet
+{
+    TaskPool::TaskPool(std::size_t threads)
+    {
+        m_threads.reserve(threads);
+        for (auto i = 0u; i < threads; ++i) {
+            m_threads.emplace_back([this](std::stop_token st) { loop(st); });
+        }
+    }
+
+    TaskPool::~TaskPool()
+    {
+        for (auto& thread : m_threads) {
+            thread.request_stop();
+        }
+        m_threads.clear();
+    }
+
+    void TaskPool::run(std::size_t count, const Task& task)
+    {
+        auto job  = Job{ .task = &task, .count = count };
+        auto lock = std::unique_lock{ m_mutex };
+        if (count > 1 and not m_threads.empty()) {
+            m_jobs.push_back(&job);
+            m_cv.notify_all();
+        }
+
+        while (run_one(lock, job)) { }
+
+        // NOTE: every task left is already running on the pool, the job can't outlive this call
+        m_done.wait(lock, [&] { return job.done == job.count; });
+    }
+
+    bool TaskPool::run_one(std::unique_lock<std::mutex>& lock, Job& job)
+    {
+        if (job.next == job.count) {
+            return false;
+        }
+
+        auto index = job.next++;
+        if (job.next == job.count) {
+            std::erase(m_jobs, &job);
+        }
+
+        lock.unlock();
+        (*job.task)(index);
+        lock.lock();
+
+        if (++job.done == job.count) {
+            m_done.notify_all();
+        }
+        return true;
+    }
+
+    void TaskPool::loop(std::stop_token st)
+    {
+        auto lock = std::unique_lock{ m_mutex };
+        while (m_cv.wait(lock, st, [&] { return not m_jobs.empty(); })) {
+            run_one(lock, *m_jobs.front());
+        }
+    }
+}
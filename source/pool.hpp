@@ -0,0 +1,56 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+namespace ascopet
+{
+    // A fixed set of threads the worker splits its drain across, also used to merge the aggregate report. The
+    // calling thread takes part in its own job and claims its tasks like the pool does, so it only ever waits
+    // for tasks that are already running: a job never waits behind another one queued before it.
+    class TaskPool
+    {
+    public:
+        using Task = std::function<void(std::size_t)>;
+
+        // no thread at all with 0, every job then runs on its calling thread
+        explicit TaskPool(std::size_t threads);
+        ~TaskPool();
+
+        TaskPool(TaskPool&&)            = delete;
+        TaskPool& operator=(TaskPool&&) = delete;
+
+        // runs task(0) to task(count - 1) and returns once they are all done, may be called from any thread
+        void run(std::size_t count, const Task& task);
+
+        std::size_t size() const { return m_threads.size(); }
+
+    private:
+        struct Job
+        {
+            const Task* task;
+            std::size_t count;
+            std::size_t next = 0;    // first task not claimed yet
+            std::size_t done = 0;
+        };
+
+        // claims the next task of the front job, false if there is none; the lock is released while it runs
+        bool run_one(std::unique_lock<std::mutex>& lock, Job& job);
+
+        void loop(std::stop_token st);
+
+        std::mutex                  m_mutex;
+        std::condition_variable_any m_cv;      // a job was queued
+        std::condition_variable     m_done;    // a task was done
+        std::deque<Job*>            m_jobs;    // the ones with tasks left to claim
+
+        // NOTE: declared last so the threads never see a partially constructed pool
+        std::vector<std::jthread> m_threads;
+    };
+}
@@ -0,0 +1,331 @@
+#include "recorder.hpp"
+
+#if not defined(_WIN32)
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <limits>
+
+namespace
+{
+    namespace rec = ascopet::recording;
+
+    // largest chunk a block may need: the description of its thread followed by the full block
+    std::size_t block_bytes(std::size_t block_records)
+    {
+        return sizeof(rec::ChunkHeader) + rec::padded(sizeof(rec::ThreadChunk)) + sizeof(rec::ChunkHeader)
+             + rec::padded(sizeof(rec::RecordsChunk) + block_records * sizeof(rec::Record));
+    }
+
+    template <typename T>
+    void store(std::byte* at, const T& value)
+    {
+        std::memcpy(at, &value, sizeof(T));
+    }
+}
+
+namespace ascopet
+{
+    Recorder::Batch::Batch(Recorder& recorder, const ThreadInfo& thread)
+        : m_recorder{ recorder }
+        , m_lock{ recorder.m_mutex }
+        , m_info{ thread }
+        , m_thread{ 0 }
+    {
+        auto& threads = m_recorder.m_threads;
+        m_thread      = threads.emplace(thread.tid, static_cast<std::uint32_t>(threads.size())).first->second;
+    }
+
+    Recorder::Batch::~Batch()
+    {
+        m_recorder.end_block();
+    }
+
+    void Recorder::Batch::add(const NamedRecord& record)
+    {
+        auto& recorder = m_recorder;
+        if (recorder.m_fd < 0) {
+            return;
+        }
+
+        // NOTE: opening a block may rotate to a new file that doesn't describe the site yet
+        while (not recorder.m_block or recorder.m_block_count == recorder.m_param.block_records
+               or not recorder.knows_site(record.site)) {
+            recorder.end_block();
+
+            auto ok = recorder.knows_site(record.site) ? recorder.begin_block(m_thread, m_info)
+                                                       : recorder.write_site(record.site);
+            if (not ok) {
+                recorder.fail();
+                return;
+            }
+        }
+
+        auto offset = *recorder.m_block + sizeof(rec::ChunkHeader) + sizeof(rec::RecordsChunk)
+                    + recorder.m_block_count * sizeof(rec::Record);
+
+        auto flags = static_cast<std::uint32_t>(record.flags) | static_cast<std::uint32_t>(record.depth) << 8
+                   | static_cast<std::uint32_t>(record.weight) << 16;
+        store(recorder.at(offset), rec::Record{ record.site, flags, record.start, record.end });
+        ++recorder.m_block_count;
+    }
+
+    Recorder::Recorder(std::uint64_t freq, std::uint64_t overhead, std::uint64_t serialized_overhead)
+        : m_freq{ freq }
+        , m_overhead{ overhead }
+        , m_serialized_overhead{ serialized_overhead }
+    {
+    }
+
+    Recorder::~Recorder()
+    {
+        stop();
+    }
+
+    bool Recorder::start(RecordParam param)
+    {
+        stop();
+
+#if defined(_WIN32)
+        (void)param;
+        return false;
+#else
+        auto lock = std::lock_guard{ m_mutex };
+
+        // the count of a block is 32 bits wide
+        constexpr auto max_block_records = std::size_t{ std::numeric_limits<std::uint32_t>::max() };
+
+        auto page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+
+        param.block_records = std::clamp(param.block_records, std::size_t{ 1 }, max_block_records);
+        auto block          = block_bytes(param.block_records);
+
+        // the window starts at a page boundary before the write position, so a page is lost to alignment
+        m_map_size = (std::max(min_map_size, 2 * block + page) + page - 1) / page * page;
+
+        // a file must at least hold its header, a site and a block, or the rotation would never end
+        if (param.max_file_size > 0) {
+            param.max_file_size = std::max(param.max_file_size, 2 * block + page);
+        }
+
+        m_param = std::move(param);
+        m_index = 0;
+        m_threads.clear();
+
+        if (not open_file()) {
+            close_file();
+            return false;
+        }
+
+        m_active.store(true, std::memory_order::relaxed);
+        return true;
+#endif
+    }
+
+    void Recorder::stop()
+    {
+        auto lock = std::lock_guard{ m_mutex };
+        close_file();
+        m_active.store(false, std::memory_order::relaxed);
+    }
+
+    bool Recorder::open_file()
+    {
+#if defined(_WIN32)
+        return false;
+#else
+        auto path = m_index == 0 ? m_param.path : m_param.path + '.' + std::to_string(m_index);
+
+        m_fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (m_fd < 0) {
+            return false;
+        }
+
+        m_size = 0;
+        m_threads_known.clear();
+        m_sites_known.clear();
+
+        if (not reserve(sizeof(rec::FileHeader))) {
+            return false;
+        }
+
+        auto header = rec::FileHeader{
+            .magic               = {},
+            .version             = rec::version,
+            .index               = m_index,
+            .tsc_freq            = m_freq,
+            .overhead            = m_overhead,
+            .serialized_overhead = m_serialized_overhead,
+            .block_records       = m_param.block_records,
+        };
+        std::copy_n(rec::magic, sizeof(rec::magic), header.magic);
+
+        store(at(0), header);
+        m_size = rec::padded(sizeof(rec::FileHeader));
+
+        return true;
+#endif
+    }
+
+    void Recorder::close_file()
+    {
+        end_block();
+
+#if not defined(_WIN32)
+        if (m_map != nullptr) {
+            ::munmap(m_map, m_map_size);
+            m_map = nullptr;
+        }
+
+        // the mapped window went past the written part, the tail would only read as the end anyway
+        if (m_fd >= 0) {
+            [[maybe_unused]] auto ret = ::ftruncate(m_fd, static_cast<off_t>(m_size));
+            ::close(m_fd);
+            m_fd = -1;
+        }
+#endif
+    }
+
+    void Recorder::fail()
+    {
+        // there is nobody to report a failed write to, the recording just ends with what was written
+        close_file();
+        m_active.store(false, std::memory_order::relaxed);
+    }
+
+    bool Recorder::reserve(std::size_t bytes)
+    {
+        auto header = rec::padded(sizeof(rec::FileHeader));
+        auto full   = m_param.max_file_size > 0 and m_size > header and m_size + bytes > m_param.max_file_size;
+        if (full) {
+            close_file();
+            ++m_index;
+            if (not open_file()) {
+                return false;
+            }
+        }
+
+        if (m_map != nullptr and m_size + bytes <= m_map_offset + m_map_size) {
+            return true;
+        }
+
+#if defined(_WIN32)
+        return false;
+#else
+        if (m_map != nullptr) {
+            ::munmap(m_map, m_map_size);
+            m_map = nullptr;
+        }
+
+        auto page   = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        auto offset = m_size / page * page;
+
+        // NOTE: growing the file zero-fills it, so an unfinished file ends with an `end` chunk
+        if (::ftruncate(m_fd, static_cast<off_t>(offset + m_map_size)) != 0) {
+            return false;
+        }
+
+        auto* map = ::mmap(nullptr, m_map_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, static_cast<off_t>(offset));
+        if (map == MAP_FAILED) {
+            return false;
+        }
+
+        m_map        = static_cast<std::byte*>(map);
+        m_map_offset = offset;
+        return true;
+#endif
+    }
+
+    std::byte* Recorder::append(rec::ChunkKind kind, std::size_t size)
+    {
+        auto total = sizeof(rec::ChunkHeader) + rec::padded(size);
+        if (not reserve(total)) {
+            return nullptr;
+        }
+
+        auto* chunk = at(m_size);
+        store(chunk, rec::ChunkHeader{ kind, static_cast<std::uint32_t>(size) });
+        m_size += total;
+
+        return chunk + sizeof(rec::ChunkHeader);
+    }
+
+    bool Recorder::begin_block(std::uint32_t thread, const ThreadInfo& info)
+    {
+        if (not reserve(block_bytes(m_param.block_records) + rec::padded(info.name.size()))) {
+            return false;
+        }
+
+        if (thread >= m_threads_known.size() or not m_threads_known[thread]) {
+            if (not write_thread(thread, info)) {
+                return false;
+            }
+        }
+
+        m_block        = m_size;
+        m_block_thread = thread;
+        m_block_count  = 0;
+        return true;
+    }
+
+    void Recorder::end_block()
+    {
+        if (not m_block) {
+            return;
+        }
+
+        // the header goes last, a block that is still being filled reads as the end of the file
+        if (m_block_count > 0) {
+            auto  size  = sizeof(rec::RecordsChunk) + m_block_count * sizeof(rec::Record);
+            auto* chunk = at(*m_block);
+
+            store(chunk + sizeof(rec::ChunkHeader), rec::RecordsChunk{ m_block_thread, m_block_count });
+            store(chunk, rec::ChunkHeader{ rec::ChunkKind::records, static_cast<std::uint32_t>(size) });
+
+            m_size = *m_block + sizeof(rec::ChunkHeader) + rec::padded(size);
+        }
+
+        m_block.reset();
+        m_block_count = 0;
+    }
+
+    bool Recorder::write_site(SiteId id)
+    {
+        auto  name  = site(id).name;
+        auto* chunk = append(rec::ChunkKind::site, sizeof(rec::SiteChunk) + name.size());
+        if (chunk == nullptr) {
+            return false;
+        }
+
+        store(chunk, rec::SiteChunk{ id, static_cast<std::uint32_t>(name.size()) });
+        std::memcpy(chunk + sizeof(rec::SiteChunk), name.data(), name.size());
+
+        if (id >= m_sites_known.size()) {
+            m_sites_known.resize(id + 1);
+        }
+        m_sites_known[id] = true;
+        return true;
+    }
+
+    bool Recorder::write_thread(std::uint32_t thread, const ThreadInfo& info)
+    {
+        auto* chunk = append(rec::ChunkKind::thread, sizeof(rec::ThreadChunk) + info.name.size());
+        if (chunk == nullptr) {
+            return false;
+        }
+
+        store(chunk, rec::ThreadChunk{ thread, static_cast<std::uint32_t>(info.name.size()), info.tid });
+        std::memcpy(chunk + sizeof(rec::ThreadChunk), info.name.data(), info.name.size());
+
+        if (thread >= m_threads_known.size()) {
+            m_threads_known.resize(thread + 1);
+        }
+        m_threads_known[thread] = true;
+        return true;
+    }
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "ascopet/ascopet.hpp"
+#include "ascopet/recording.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ascopet
+{
+    // Appends drained records to a memory-mapped file (see recording.hpp for the layout). The file is mapped
+    // one window at a time, the records are written straight into the mapping and the window slides forward as
+    // the file grows, so the only syscalls on the way are the occasional remap and the truncate of the file.
+    class Recorder
+    {
+    public:
+        // the records of one thread's drain, the recorder stays locked while it is alive
+        class Batch
+        {
+        public:
+            Batch(Recorder& recorder, const ThreadInfo& thread);
+            ~Batch();
+
+            Batch(Batch&&)            = delete;
+            Batch& operator=(Batch&&) = delete;
+
+            // does nothing if the recording was stopped before the batch was created
+            void add(const NamedRecord& record);
+
+        private:
+            Recorder&                    m_recorder;
+            std::unique_lock<std::mutex> m_lock;
+            const ThreadInfo&            m_info;
+            std::uint32_t                m_thread;
+        };
+
+        Recorder(std::uint64_t freq, std::uint64_t overhead, std::uint64_t serialized_overhead);
+        ~Recorder();
+
+        // starts a new recording, stopping the one in progress if any; false if the file can't be created
+        bool start(RecordParam param);
+        void stop();
+
+        bool active() const { return m_active.load(std::memory_order::relaxed); }
+
+    private:
+        // the window is at least this large, and always large enough for a full block
+        static constexpr std::size_t min_map_size = std::size_t{ 16 } << 20;
+
+        bool open_file();
+        void close_file();
+        void fail();
+
+        // maps the next `bytes` of the file, rotating to a new file first if they would exceed its max size
+        bool reserve(std::size_t bytes);
+
+        // appends a chunk of `size` bytes of payload, returns where to write the payload or null on failure
+        std::byte* append(recording::ChunkKind kind, std::size_t size);
+
+        bool begin_block(std::uint32_t thread, const ThreadInfo& info);
+        void end_block();
+        bool write_site(SiteId site);
+        bool write_thread(std::uint32_t thread, const ThreadInfo& info);
+        bool knows_site(SiteId site) const { return site < m_sites_known.size() and m_sites_known[site]; }
+
+        std::byte* at(std::size_t offset) const { return m_map + (offset - m_map_offset); }
+
+        std::mutex        m_mutex;
+        std::atomic<bool> m_active = false;
+
+        const std::uint64_t m_freq;
+        const std::uint64_t m_overhead;
+        const std::uint64_t m_serialized_overhead;
+
+        RecordParam   m_param;
+        std::size_t   m_map_size = 0;
+        std::uint32_t m_index    = 0;    // of the current file in the rotation
+
+        int         m_fd         = -1;
+        std::byte*  m_map        = nullptr;
+        std::size_t m_map_offset = 0;    // file offset of the mapped window
+        std::size_t m_size       = 0;    // bytes of the current file written so far
+
+        std::optional<std::size_t> m_block;    // offset of the open records chunk
+        std::uint32_t              m_block_thread = 0;
+        std::uint32_t              m_block_count  = 0;
+
+        // keyed by OS thread id, numbered in order of appearance
+        std::unordered_map<std::uint64_t, std::uint32_t> m_threads;
+
+        std::vector<bool> m_threads_known;    // described in the current file, indexed by thread number
+        std::vector<bool> m_sites_known;      // same for the sites, indexed by SiteId
+    };
+}
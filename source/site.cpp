@@ -0,0 +1,186 @@
+#include "ascopet/common.hpp"
+#include "ascopet/site.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+namespace
+{
+    class SiteRegistry
+    {
+    public:
+        ascopet::SiteId add(std::string_view name, std::source_location location)
+        {
+            {
+                auto lock = std::shared_lock{ m_mutex };
+                if (auto it = m_ids.find(name); it != m_ids.end()) {
+                    return it->second;
+                }
+            }
+
+            auto lock           = std::unique_lock{ m_mutex };
+            auto id             = static_cast<ascopet::SiteId>(m_sites.size());
+            auto [it, inserted] = m_ids.try_emplace(std::string{ name }, id);
+            if (inserted) {
+                // NOTE: map keys are node-based so the name view stays valid on rehash
+                m_sites.push_back({ .name = it->first, .file = location.file_name(), .line = location.line() });
+            }
+            return it->second;
+        }
+
+        ascopet::Site get(ascopet::SiteId id) const
+        {
+            auto lock = std::shared_lock{ m_mutex };
+            assert(id < m_sites.size());
+            return m_sites[id];
+        }
+
+        std::size_t size() const
+        {
+            auto lock = std::shared_lock{ m_mutex };
+            return m_sites.size();
+        }
+
+        void set_sampling(ascopet::SiteId id, ascopet::Sampling sampling)
+        {
+            auto limit = sampling.random ? (ascopet::max_sampling_gap + 1) / 2 : ascopet::max_sampling_gap;
+            sampling.every = std::clamp(sampling.every, 1u, limit);
+
+            auto lock           = std::unique_lock{ m_mutex };
+            config(id).sampling = sampling;
+            bump_epoch();
+        }
+
+        void set_enabled(ascopet::SiteId id, bool enabled)
+        {
+            auto lock          = std::unique_lock{ m_mutex };
+            config(id).enabled = enabled;
+            bump_epoch();
+        }
+
+        ascopet::SiteConfig config_of(ascopet::SiteId id) const
+        {
+            auto lock = std::shared_lock{ m_mutex };
+            return id < m_configs.size() ? m_configs[id] : ascopet::SiteConfig{};
+        }
+
+        std::vector<ascopet::SiteConfig> configs() const
+        {
+            auto lock = std::shared_lock{ m_mutex };
+            return m_configs;
+        }
+
+    private:
+        ascopet::SiteConfig& config(ascopet::SiteId id)
+        {
+            if (id >= m_configs.size()) {
+                m_configs.resize(id + 1);
+            }
+            return m_configs[id];
+        }
+
+        // NOTE: wraps around to 1, 0 is reserved for "never configured"
+        static void bump_epoch()
+        {
+            auto epoch = ascopet::detail::s_site_epoch.load(std::memory_order::relaxed) + 1;
+            ascopet::detail::s_site_epoch.store(epoch == 0 ? 1 : epoch, std::memory_order::release);
+        }
+
+        mutable std::shared_mutex        m_mutex;
+        ascopet::StrMap<ascopet::SiteId> m_ids;
+        std::deque<ascopet::Site>        m_sites;
+        std::vector<ascopet::SiteConfig> m_configs;    // indexed by SiteId, only up to the last configured site
+    };
+
+    SiteRegistry& registry()
+    {
+        static auto registry = SiteRegistry{};
+        return registry;
+    }
+
+    // names interned by this thread, keyed by content since the caller's storage doesn't outlive the call
+    thread_local auto t_interned = ascopet::StrMap<ascopet::SiteId>{};
+
+    // the last one, names are interned in loops more often than not and a compare is cheaper than a hash
+    thread_local const std::pair<const std::string, ascopet::SiteId>* t_last_interned = nullptr;
+}
+
+namespace ascopet
+{
+    SiteId register_site(std::string_view name, std::source_location location)
+    {
+        return registry().add(name, location);
+    }
+
+    SiteId register_site(std::source_location location)
+    {
+        auto name = std::string{ location.function_name() } + ':' + std::to_string(location.line());
+        return registry().add(name, location);
+    }
+
+    SiteId intern(std::string_view name)
+    {
+        if (t_last_interned != nullptr and t_last_interned->first == name) {
+            return t_last_interned->second;
+        }
+
+        auto it = t_interned.find(name);
+        if (it == t_interned.end()) {
+            it = t_interned.emplace(name, registry().add(name, {})).first;
+        }
+
+        // NOTE: map nodes are stable, the pointer stays valid as the table grows
+        t_last_interned = &*it;
+        return it->second;
+    }
+
+    Site site(SiteId id)
+    {
+        return registry().get(id);
+    }
+
+    std::size_t site_count()
+    {
+        return registry().size();
+    }
+
+    void set_sampling(SiteId id, Sampling sampling)
+    {
+        registry().set_sampling(id, sampling);
+    }
+
+    void set_sampling(std::string_view name, Sampling sampling)
+    {
+        registry().set_sampling(register_site(name), sampling);
+    }
+
+    Sampling sampling(SiteId id)
+    {
+        return registry().config_of(id).sampling;
+    }
+
+    void set_enabled(SiteId id, bool enabled)
+    {
+        registry().set_enabled(id, enabled);
+    }
+
+    void set_enabled(std::string_view name, bool enabled)
+    {
+        registry().set_enabled(register_site(name), enabled);
+    }
+
+    bool is_enabled(SiteId id)
+    {
+        return registry().config_of(id).enabled;
+    }
+
+    std::vector<SiteConfig> site_configs()
+    {
+        return registry().configs();
+    }
+}
@@ -0,0 +1,22 @@
+# cmake -DNM=<nm> -DOBJECT=<object file> -DEXPECT=<absent|present> -P check_symbols.cmake
+#
+# Looks for what a trace that is compiled in leaves in an object: the registration of its site, the static
+# holding the site and the acquisition of the tls buffer.
+
+execute_process(
+  COMMAND ${NM} -C ${OBJECT}
+  OUTPUT_VARIABLE symbols
+  RESULT_VARIABLE result
+)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "${NM} failed on ${OBJECT}")
+endif()
+
+foreach(pattern "register_site" "acquire_localbuf" "ascopet::trace<[^\n]*\\(std::source_location\\)::site")
+  string(REGEX MATCH "[^\n]*${pattern}[^\n]*" found "${symbols}")
+  if(EXPECT STREQUAL "absent" AND found)
+    message(FATAL_ERROR "a compiled out trace left `${found}` in ${OBJECT}")
+  elseif(EXPECT STREQUAL "present" AND NOT found)
+    message(FATAL_ERROR "nothing matches `${pattern}` in ${OBJECT}, the check would pass by accident")
+  endif()
+endforeach()
@@ -0,0 +1,122 @@
+// The aggregate report pools the stats of every thread, so a site traced by several threads gets the same count,
+// mean, stdev, extremes and quantiles as a single list fed every record of every thread. There are enough sites
+// for the merge to be split across the pool.
+
+#include <ascopet/ascopet.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+    int g_failures = 0;
+
+    volatile std::uint64_t g_sink = 0;    // keeps the busy loops
+
+    void check(bool ok, const char* what, std::uint64_t value)
+    {
+        if (not ok) {
+            std::fprintf(stderr, "FAILED: %s (got %llu)\n", what, static_cast<unsigned long long>(value));
+            ++g_failures;
+        }
+    }
+
+    // the pooled values go through a different sum than the single fold, only the rounding may differ
+    bool close(ascopet::StatDuration pooled, ascopet::StatDuration single)
+    {
+        return std::abs(pooled.count() - single.count()) <= 1e-6 * std::max(1.0, std::abs(single.count()));
+    }
+
+    std::uint64_t ns(ascopet::StatDuration duration)
+    {
+        return static_cast<std::uint64_t>(duration.count());
+    }
+}
+
+int main()
+{
+    constexpr auto threads  = 4u;
+    constexpr auto sites    = 256u;
+    constexpr auto per_site = 8u;
+
+    auto* ascopet = ascopet::init({
+        .immediately_start = true,
+        .poll_interval     = 10ms,
+        .record_capacity   = threads * per_site,    // so the raw records of every thread are all still there
+        .buffer_capacity   = 4096,
+        .drain_threads     = 2,
+    });
+
+    auto ids = std::vector<ascopet::SiteId>{};
+    for (auto i = 0u; i < sites; ++i) {
+        ids.push_back(ascopet::register_site("aggregate/" + std::to_string(i)));
+    }
+
+    // each thread spins for a different time so the threads' stats differ
+    {
+        auto workers = std::vector<std::jthread>{};
+        for (auto t = 0u; t < threads; ++t) {
+            workers.emplace_back([&, t] {
+                for (auto i = 0u; i < sites * per_site; ++i) {
+                    auto tracer = ascopet::trace(ids[i % sites]);
+                    for (auto spin = 0u; spin < (t + 1) * 100; ++spin) {
+                        g_sink = g_sink + spin;
+                    }
+                }
+            });
+        }
+    }
+
+    // an exited thread is reported alive until the worker has drained what it left
+    auto settled = [&] {
+        auto report = ascopet->thread_report();
+        return std::ranges::none_of(report, [](const auto& entry) { return entry.second.alive; });
+    };
+    for (auto i = 0; i < 200 and not settled(); ++i) {
+        std::this_thread::sleep_for(10ms);
+    }
+
+    auto single = ascopet::TimingList{ threads * per_site };
+    for (const auto& [_, entries] : ascopet->raw_report()) {
+        for (const auto& [name, records] : entries) {
+            auto site = ascopet::register_site(name);
+            for (auto i = 0u; i < records.size(); ++i) {
+                single.push_back({ .site = site, .start = records[i].start, .end = records[i].end });
+            }
+        }
+    }
+    single.flush();
+
+    auto expected  = single.stat(ascopet->tsc_freq());
+    auto aggregate = ascopet->aggregate_report();
+    check(aggregate.size() == sites, "sites in the aggregate report", aggregate.size());
+
+    for (const auto& [name, stat] : expected) {
+        auto it = aggregate.find(name);
+        if (it == aggregate.end()) {
+            std::fprintf(stderr, "FAILED: %s is missing from the aggregate report\n", name.c_str());
+            ++g_failures;
+            continue;
+        }
+
+        const auto& pooled = it->second.duration;
+        check(it->second.count == threads * per_site, "count of a site", it->second.count);
+        check(close(pooled.mean, stat.duration.mean), "pooled mean", ns(pooled.mean));
+        check(close(pooled.stdev, stat.duration.stdev), "pooled stdev", ns(pooled.stdev));
+        check(pooled.min == stat.duration.min, "pooled min", ns(pooled.min));
+        check(pooled.max == stat.duration.max, "pooled max", ns(pooled.max));
+
+        // the histograms merge exactly, so their quantiles are those of the single list
+        check(pooled.median == stat.duration.median, "merged median", ns(pooled.median));
+        check(pooled.p99 == stat.duration.p99, "merged p99", ns(pooled.p99));
+    }
+
+    return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,167 @@
+// The call tree rebuilt from the depth of the records gives every path the time spent in it minus the time of
+// its traced children as self time, both for records fed by hand and for nested scopes traced by a thread, and
+// the folded stacks carry the same self times.
+
+#include <ascopet/ascopet.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+    int g_failures = 0;
+
+    void check(bool ok, const char* what, std::uint64_t value)
+    {
+        if (not ok) {
+            std::fprintf(stderr, "FAILED: %s (got %llu)\n", what, static_cast<unsigned long long>(value));
+            ++g_failures;
+        }
+    }
+
+    std::string joined(const std::vector<std::string_view>& path)
+    {
+        auto out = std::string{};
+        for (auto name : path) {
+            out += out.empty() ? "" : ";";
+            out += name;
+        }
+        return out;
+    }
+
+    volatile std::uint64_t g_sink = 0;    // keeps the busy loops
+
+    void work(std::uint64_t spins)
+    {
+        for (auto i = 0u; i < spins; ++i) {
+            g_sink = g_sink + i;
+        }
+    }
+}
+
+int main()
+{
+    // records in the order their scopes end: request { parse { decode } render }, twice
+    {
+        auto request = ascopet::register_site("calltree/request");
+        auto parse   = ascopet::register_site("calltree/parse");
+        auto decode  = ascopet::register_site("calltree/decode");
+        auto render  = ascopet::register_site("calltree/render");
+
+        auto tree = ascopet::CallTree{};
+        for (auto i = 0; i < 2; ++i) {
+            tree.add(decode, 2, 10);
+            tree.add(parse, 1, 30);
+            tree.add(render, 1, 20);
+            tree.add(request, 0, 100);
+        }
+
+        auto nodes = std::map<std::string, ascopet::CallTree::Node>{};
+        tree.for_each_path([&](std::span<const ascopet::SiteId> path, const ascopet::CallTree::Node& node) {
+            auto names = std::vector<std::string_view>{};
+            for (auto id : path) {
+                names.push_back(ascopet::site(id).name);
+            }
+            nodes.emplace(joined(names), node);
+        });
+
+        auto expect = [&](const char* path, std::uint64_t inclusive, std::uint64_t self) {
+            auto it = nodes.find(path);
+            if (it == nodes.end()) {
+                std::fprintf(stderr, "FAILED: no path %s\n", path);
+                ++g_failures;
+                return;
+            }
+            check(it->second.count == 2, path, it->second.count);
+            check(it->second.inclusive == inclusive, path, it->second.inclusive);
+            check(it->second.self == self, path, it->second.self);
+        };
+        check(nodes.size() == 4, "paths of the tree", nodes.size());
+        expect("calltree/request", 200, 100);
+        expect("calltree/request;calltree/parse", 60, 40);
+        expect("calltree/request;calltree/parse;calltree/decode", 20, 20);
+        expect("calltree/request;calltree/render", 40, 40);
+    }
+
+    // the same shape traced by a thread
+    auto* ascopet = ascopet::init({
+        .immediately_start = true,
+        .poll_interval     = 10ms,
+        .buffer_capacity   = 4096,
+        .call_tree         = true,
+    });
+
+    std::thread{ [] {
+        for (auto i = 0; i < 100; ++i) {
+            auto request = ascopet::trace<"traced/request">();
+            work(200);
+            {
+                auto parse = ascopet::trace<"traced/parse">();
+                work(100);
+                auto decode = ascopet::trace<"traced/decode">();
+                work(300);
+            }
+            auto render = ascopet::trace<"traced/render">();
+            work(100);
+        }
+    } }.join();
+
+    // an exited thread is reported alive until the worker has drained what it left
+    auto settled = [&] {
+        auto report = ascopet->thread_report();
+        return std::ranges::none_of(report, [](const auto& entry) { return entry.second.alive; });
+    };
+    for (auto i = 0; i < 200 and not settled(); ++i) {
+        std::this_thread::sleep_for(10ms);
+    }
+
+    auto paths = std::map<std::string, ascopet::CallStat>{};
+    for (const auto& [_, stats] : ascopet->call_report()) {
+        for (const auto& stat : stats) {
+            paths.emplace(joined(stat.path), stat);
+        }
+    }
+    check(paths.size() == 4, "paths of the traced thread", paths.size());
+
+    // a child's path is its parent's plus its own site, so the direct children are one name longer
+    for (const auto& [path, stat] : paths) {
+        auto children = ascopet::StatDuration{ 0 };
+        for (const auto& [other, child] : paths) {
+            if (child.path.size() == stat.path.size() + 1 and other.starts_with(path + ";")) {
+                children += child.inclusive;
+            }
+        }
+        auto expected = stat.inclusive - children;
+        check(stat.count == 100, path.c_str(), stat.count);
+        check(
+            std::abs(stat.self.count() - expected.count()) <= 1e-6 * stat.inclusive.count(),
+            path.c_str(),
+            static_cast<std::uint64_t>(stat.self.count())
+        );
+    }
+
+    // one `path self` line per path, with the self time in ns
+    auto lines  = std::istringstream{ ascopet->folded_stacks() };
+    auto folded = std::size_t{ 0 };
+    for (auto line = std::string{}; std::getline(lines, line);) {
+        auto space = line.rfind(' ');
+        auto it    = paths.find(line.substr(0, space));
+        if (it == paths.end()) {
+            continue;
+        }
+        ++folded;
+        auto self = std::stod(line.substr(space + 1));
+        check(std::abs(self - it->second.self.count()) < 2.0, line.c_str(), static_cast<std::uint64_t>(self));
+    }
+    check(folded == 4, "folded stacks of the traced thread", folded);
+
+    return g_failures == 0 ? 0 : 1;
+}
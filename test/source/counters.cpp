@@ -0,0 +1,122 @@
+// Counters, gauges and instant events traced by a thread add up to their exact totals in the counter report, and
+// a counter attached to a scope gets the sum of its increments within that scope over the time spent in it.
+
+#include <ascopet/ascopet.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+    int g_failures = 0;
+
+    void check(bool ok, const char* what, std::uint64_t value)
+    {
+        if (not ok) {
+            std::fprintf(stderr, "FAILED: %s (got %llu)\n", what, static_cast<unsigned long long>(value));
+            ++g_failures;
+        }
+    }
+}
+
+int main()
+{
+    // five scopes of 1000 ticks with 10 attached each, at one tick per ns: 50 in 5us
+    {
+        auto scope = ascopet::register_site("counters/list/scope");
+        auto bytes = ascopet::register_site("counters/list/bytes");
+        auto list  = ascopet::TimingList{ 64 };
+        for (auto i = 0u; i < 5; ++i) {
+            auto start = 10'000 + i * std::uint64_t{ 2000 };
+            auto flags = std::uint8_t{ ascopet::NamedRecord::counter };
+            flags      = static_cast<std::uint8_t>(flags | ascopet::NamedRecord::attached);
+            list.push_back({ .site = bytes, .flags = flags, .start = start + 500, .end = 10 });
+            list.push_back({ .site = scope, .start = start, .end = start + 1000 });
+        }
+        list.flush();
+
+        auto stats = list.counter_stat(1'000'000'000);
+        auto total = stats["counters/list/bytes"];
+        check(total.sum == 50, "sum of an attached counter", total.sum);
+
+        auto within = total.scopes["counters/list/scope"];
+        check(within.sum == 50, "sum of an attached counter within its scope", within.sum);
+        auto time = within.time.count();
+        check(std::abs(time - 5000.0) < 1e-6, "time of the scopes", static_cast<std::uint64_t>(time));
+        check(
+            std::abs(within.per_second - 1e7) < 1e-3,
+            "throughput within the scope",
+            static_cast<std::uint64_t>(within.per_second)
+        );
+    }
+
+    auto* ascopet = ascopet::init({
+        .immediately_start = true,
+        .poll_interval     = 10ms,
+        .buffer_capacity   = 4096,
+    });
+
+    auto bytes = ascopet::register_site("counters/bytes");
+    std::thread{ [bytes] {
+        for (auto i = 1u; i <= 100; ++i) {
+            ascopet::count<"counters/requests">(i);
+        }
+        for (auto value : { 10u, 30u, 20u }) {
+            ascopet::gauge<"counters/depth">(value);
+        }
+        for (auto i = 0; i < 7; ++i) {
+            ascopet::mark<"counters/miss">();
+        }
+        for (auto i = 0; i < 50; ++i) {
+            auto tracer = ascopet::trace<"counters/decode">();
+            tracer.count(bytes, 64);
+        }
+    } }.join();
+
+    // an exited thread is reported alive until the worker has drained what it left
+    auto settled = [&] {
+        auto report = ascopet->thread_report();
+        return std::ranges::none_of(report, [](const auto& entry) { return entry.second.alive; });
+    };
+    for (auto i = 0; i < 200 and not settled(); ++i) {
+        std::this_thread::sleep_for(10ms);
+    }
+
+    auto report = ascopet->report_counters();
+    check(report.size() == 1, "threads with counters", report.size());
+    if (report.empty()) {
+        return 1;
+    }
+    auto& stats = report.begin()->second;
+
+    const auto& requests = stats["counters/requests"];
+    check(requests.kind == ascopet::NamedRecord::counter, "kind of a counter", requests.kind);
+    check(requests.count == 100, "increments of a counter", requests.count);
+    check(requests.sum == 5050, "sum of a counter", requests.sum);
+    check(requests.min == 1 and requests.max == 100, "extremes of a counter", requests.max);
+    check(requests.last == 100, "last increment of a counter", requests.last);
+
+    const auto& depth = stats["counters/depth"];
+    check(depth.kind == ascopet::NamedRecord::gauge, "kind of a gauge", depth.kind);
+    check(depth.count == 3, "samples of a gauge", depth.count);
+    check(depth.last == 20, "last sample of a gauge", depth.last);
+    check(depth.min == 10 and depth.max == 30, "extremes of a gauge", depth.max);
+    check(std::abs(depth.mean - 20.0) < 1e-9, "mean of a gauge", static_cast<std::uint64_t>(depth.mean));
+
+    const auto& miss = stats["counters/miss"];
+    check(miss.kind == ascopet::NamedRecord::instant, "kind of an instant event", miss.kind);
+    check(miss.count == 7, "instant events", miss.count);
+
+    auto& attached = stats["counters/bytes"];
+    check(attached.sum == 50 * 64, "sum of an attached counter", attached.sum);
+    auto& decode = attached.scopes["counters/decode"];
+    check(decode.sum == 50 * 64, "sum of an attached counter within its scope", decode.sum);
+    check(decode.time.count() > 0, "time of the scopes", static_cast<std::uint64_t>(decode.time.count()));
+
+    return g_failures == 0 ? 0 : 1;
+}
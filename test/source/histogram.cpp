@@ -0,0 +1,81 @@
+// The quantiles of a histogram are within `relative_error` (1/64) of the exact nearest-rank quantiles of the
+// values added to it, whatever their spread, and merging histograms gives the same quantiles as adding every
+// value to a single one.
+
+#include <ascopet/histogram.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+    int g_failures = 0;
+
+    void check(bool ok, const char* what, std::uint64_t value)
+    {
+        if (not ok) {
+            std::fprintf(stderr, "FAILED: %s (got %llu)\n", what, static_cast<unsigned long long>(value));
+            ++g_failures;
+        }
+    }
+
+    // nearest-rank, like Histogram::quantile
+    std::uint64_t exact_quantile(const std::vector<std::uint64_t>& sorted, double q)
+    {
+        auto rank = static_cast<std::size_t>(std::ceil(q * static_cast<double>(sorted.size())));
+        return sorted[std::max(rank, std::size_t{ 1 }) - 1];
+    }
+}
+
+int main()
+{
+    constexpr auto   count       = std::size_t{ 200'000 };
+    constexpr double quantiles[] = { 0.0, 0.01, 0.1, 0.25, 0.5, 0.75, 0.9, 0.99, 0.999, 0.9999, 1.0 };
+
+    // log-uniform over 9 decades, so every range of buckets gets its share, plus the exact ones below 2^sub_bits
+    auto rng      = std::mt19937_64{ 42 };
+    auto exponent = std::uniform_real_distribution<double>{ 0.0, 9.0 };
+
+    auto values = std::vector<std::uint64_t>{};
+    auto whole  = ascopet::Histogram{};
+    auto halves = std::pair<ascopet::Histogram, ascopet::Histogram>{};
+    for (auto i = 0u; i < count; ++i) {
+        auto value = static_cast<std::uint64_t>(std::pow(10.0, exponent(rng)));
+        values.push_back(value);
+        whole.add(value);
+        (i % 2 == 0 ? halves.first : halves.second).add(value);
+    }
+    std::ranges::sort(values);
+
+    auto merged = ascopet::Histogram{};
+    merged.merge(halves.first);
+    merged.merge(halves.second);
+
+    check(whole.count() == count, "count of the histogram", whole.count());
+    check(whole.min() == values.front(), "min of the histogram", whole.min());
+    check(whole.max() == values.back(), "max of the histogram", whole.max());
+
+    for (auto q : quantiles) {
+        auto exact    = exact_quantile(values, q);
+        auto estimate = whole.quantile(q);
+        auto error    = std::abs(static_cast<double>(estimate) - static_cast<double>(exact));
+        if (error > static_cast<double>(exact) * ascopet::Histogram::relative_error) {
+            std::fprintf(
+                stderr,
+                "FAILED: quantile %g is %llu, the exact one is %llu\n",
+                q,
+                static_cast<unsigned long long>(estimate),
+                static_cast<unsigned long long>(exact)
+            );
+            ++g_failures;
+        }
+        check(merged.quantile(q) == estimate, "quantile of the merged halves", merged.quantile(q));
+    }
+
+    check(ascopet::Histogram{}.quantile(0.5) == 0, "quantile of an empty histogram", 0);
+
+    return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,74 @@
+// A name interned at runtime always gives the same id, whatever buffer it comes from, which thread interns it
+// and which name the thread interned last; it is the id a static name registers as, and the registry keeps its
+// own copy of the name once the caller's buffer is gone.
+
+#include <ascopet/site.hpp>
+
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    int g_failures = 0;
+
+    void check(bool ok, const char* what, std::uint64_t value)
+    {
+        if (not ok) {
+            std::fprintf(stderr, "FAILED: %s (got %llu)\n", what, static_cast<unsigned long long>(value));
+            ++g_failures;
+        }
+    }
+
+    std::string method(int i)
+    {
+        return "rpc/method" + std::to_string(i);
+    }
+}
+
+int main()
+{
+    constexpr auto names   = 100;
+    constexpr auto threads = 4;
+
+    auto first = ascopet::intern(method(0));
+    {
+        auto name = method(0);    // another buffer with the same content
+        check(ascopet::intern(name) == first, "id of the same name", ascopet::intern(name));
+    }
+    check(ascopet::site(first).name == method(0), "name of an interned site once its buffer is gone", first);
+    check(ascopet::register_site("rpc/method0") == first, "id of the same name registered", first);
+
+    // the last interned name is cached, switching back and forth must not mix them up
+    auto second = ascopet::intern(method(1));
+    check(second != first, "id of another name", second);
+    check(ascopet::intern(method(0)) == first, "id of a name interned again after another", first);
+    check(ascopet::intern(method(1)) == second, "id of the other name interned again", second);
+
+    // every thread interns the same names concurrently, in a different order, and gets the same ids
+    auto ids = std::vector<std::vector<ascopet::SiteId>>(threads, std::vector<ascopet::SiteId>(names));
+    {
+        auto workers = std::vector<std::jthread>{};
+        for (auto t = 0; t < threads; ++t) {
+            workers.emplace_back([&ids, t] {
+                for (auto round = 0; round < 3; ++round) {
+                    for (auto i = 0; i < names; ++i) {
+                        auto index    = t % 2 == 0 ? i : names - 1 - i;
+                        ids[t][index] = ascopet::intern(method(index));
+                    }
+                }
+            });
+        }
+    }
+
+    for (auto i = 0; i < names; ++i) {
+        for (auto t = 1; t < threads; ++t) {
+            check(ids[t][i] == ids[0][i], "id of a name interned by another thread", ids[t][i]);
+        }
+        check(ascopet::site(ids[0][i]).name == method(i), "name of a site interned by a thread", ids[0][i]);
+        check(ascopet::intern(method(i)) == ids[0][i], "id of a name interned by a thread", ids[0][i]);
+    }
+
+    return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,90 @@
+// The avx2 kernel folds random record spans into the same stats as the scalar one, including the deltas it has
+// to clamp: negative ones (an end stamped before its start), ones below the overhead and ones above max_delta,
+// and the tail of a span that isn't a whole number of vectors. The tick conversion doesn't overflow on long
+// scopes either.
+
+// the kernel is internal to the library, its header is in the source directory
+#include "kernel.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace kernel = ascopet::kernel;
+
+namespace
+{
+    int g_failures = 0;
+
+    void check(bool ok, const char* what, std::uint64_t value)
+    {
+        if (not ok) {
+            std::fprintf(stderr, "FAILED: %s (got %llu)\n", what, static_cast<unsigned long long>(value));
+            ++g_failures;
+        }
+    }
+
+    // the moments are summed in another order, only the rounding may differ
+    bool close(double value, double expected)
+    {
+        return std::abs(value - expected) <= 1e-9 * std::max(1.0, std::abs(expected));
+    }
+}
+
+int main()
+{
+    constexpr auto   overhead = std::uint64_t{ 40 };
+    constexpr double pivot    = 100.0;
+
+    if (not kernel::has_avx2()) {
+        std::fprintf(stderr, "no avx2 on this cpu, the avx2 kernel falls back to the scalar one\n");
+    }
+
+    auto rng  = std::mt19937_64{ 42 };
+    auto dist = std::lognormal_distribution<double>{ 4.6, 1.0 };
+    auto pick = std::uniform_int_distribution<int>{ 0, 15 };
+
+    for (auto n : { 0u, 1u, 3u, 4u, 5u, 17u, 1000u, 4099u }) {
+        auto starts = std::vector<std::uint64_t>(n);
+        auto ends   = std::vector<std::uint64_t>(n);
+        for (auto i = 0u; i < n; ++i) {
+            starts[i] = 1'000'000'000 + i * std::uint64_t{ 1000 };
+            switch (pick(rng)) {
+            case 0: ends[i] = starts[i] - 1 - static_cast<std::uint64_t>(dist(rng)); break;    // negative
+            case 1: ends[i] = starts[i] + overhead / 2; break;                                 // below the overhead
+            case 2: ends[i] = starts[i] + (kernel::max_delta << 2); break;                     // clamped
+            default: ends[i] = starts[i] + static_cast<std::uint64_t>(dist(rng)); break;
+            }
+        }
+
+        auto scalar = kernel::delta_stat_scalar(starts.data(), ends.data(), n, overhead, pivot);
+        auto avx2   = kernel::delta_stat_avx2(starts.data(), ends.data(), n, overhead, pivot);
+
+        check(avx2.count == scalar.count, "count of the avx2 kernel", avx2.count);
+        check(avx2.sum == scalar.sum, "sum of the avx2 kernel", avx2.sum);
+        check(avx2.min == scalar.min, "min of the avx2 kernel", avx2.min);
+        check(avx2.max == scalar.max, "max of the avx2 kernel", avx2.max);
+        check(close(avx2.sum_dy, scalar.sum_dy), "sum_dy of the avx2 kernel", n);
+        check(close(avx2.sum_sq, scalar.sum_sq), "sum_sq of the avx2 kernel", n);
+
+        // and the scalar kernel is the per-record delta
+        auto sum = std::uint64_t{ 0 };
+        for (auto i = 0u; i < n; ++i) {
+            sum += kernel::delta(starts[i], ends[i], overhead);
+        }
+        check(scalar.sum == sum, "sum of the scalar kernel", scalar.sum);
+    }
+
+    // `ticks * 1e9` overflows 64 bits past ~7s at 2.5 GHz, a scope of 1000s must still convert
+    auto freq  = std::uint64_t{ 2'500'000'000 };
+    auto scale = kernel::TickScale{ freq };
+    for (auto seconds : { std::uint64_t{ 1 }, std::uint64_t{ 10 }, std::uint64_t{ 1000 } }) {
+        auto ns       = static_cast<double>(scale.to_duration(seconds * freq).count());
+        auto expected = static_cast<double>(seconds) * 1e9;
+        check(std::abs(ns - expected) <= 1e-8 * expected, "ns of a long scope", static_cast<std::uint64_t>(ns));
+    }
+
+    return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,24 @@
+// Compiled with ASCOPET_LEVEL below the level of its traces, then checked by check_symbols.cmake: nothing of the
+// traces may be left in the object, neither the registration of their sites nor the read of the tls buffer.
+// The same file compiled with every level in is checked for both, so the check can't pass by accident.
+
+#include <ascopet/ascopet.hpp>
+
+#include <type_traits>
+
+#if ASCOPET_LEVEL < 3
+static_assert(std::is_empty_v<ascopet::NullTracer>);
+static_assert(std::is_same_v<decltype(ascopet::trace<"level/fine", ascopet::Level::fine>()), ascopet::NullTracer>);
+#endif
+
+int traced_fine(int value)
+{
+    ASCOPET_TRACE_LEVEL(fine, "level/fine");
+    return value * 3;
+}
+
+int traced_serialized(int value)
+{
+    auto tracer = ascopet::trace<"level/serialized", ascopet::Level::fine, ascopet::Timing::serialized>();
+    return value + 7;
+}
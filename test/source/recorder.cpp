@@ -0,0 +1,180 @@
+// Every record drained while recording ends up in the file, in blocks that describe their sites and threads, so
+// replaying the file through a TimingList gives the same stats as the live report of the thread that traced.
+
+#include <ascopet/ascopet.hpp>
+#include <ascopet/recording.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+namespace rec = ascopet::recording;
+
+namespace
+{
+    int g_failures = 0;
+
+    void check(bool ok, const char* what, std::uint64_t value)
+    {
+        if (not ok) {
+            std::fprintf(stderr, "FAILED: %s (got %llu)\n", what, static_cast<unsigned long long>(value));
+            ++g_failures;
+        }
+    }
+
+    template <typename T>
+    T load(const char* at)
+    {
+        auto value = T{};
+        std::memcpy(&value, at, sizeof(T));
+        return value;
+    }
+
+    struct Replay
+    {
+        rec::FileHeader                             header  = {};
+        std::uint64_t                               records = 0;
+        std::vector<std::uint64_t>                  tids;
+        std::vector<std::optional<ascopet::SiteId>> sites;    // by site id in the file
+    };
+
+    // feeds every record of the file into `list`, like ascopet-read does
+    bool replay(const std::vector<char>& data, ascopet::TimingList& list, Replay& state)
+    {
+        if (data.size() < sizeof(rec::FileHeader)) {
+            return false;
+        }
+        state.header = load<rec::FileHeader>(data.data());
+        if (std::memcmp(state.header.magic, rec::magic, sizeof(rec::magic)) != 0) {
+            return false;
+        }
+
+        auto offset = rec::padded(sizeof(rec::FileHeader));
+        while (offset + sizeof(rec::ChunkHeader) <= data.size()) {
+            auto chunk   = load<rec::ChunkHeader>(data.data() + offset);
+            auto payload = data.data() + offset + sizeof(rec::ChunkHeader);
+            if (chunk.kind == rec::ChunkKind::end or offset + sizeof(rec::ChunkHeader) + chunk.size > data.size()) {
+                break;
+            }
+
+            if (chunk.kind == rec::ChunkKind::site) {
+                auto site = load<rec::SiteChunk>(payload);
+                state.sites.resize(std::max<std::size_t>(state.sites.size(), site.site + 1));
+                state.sites[site.site] = ascopet::register_site({ payload + sizeof(site), site.length });
+            } else if (chunk.kind == rec::ChunkKind::thread) {
+                state.tids.push_back(load<rec::ThreadChunk>(payload).tid);
+            } else if (chunk.kind == rec::ChunkKind::records) {
+                auto block = load<rec::RecordsChunk>(payload);
+                for (auto i = 0u; i < block.count; ++i) {
+                    auto record = load<rec::Record>(payload + sizeof(block) + i * sizeof(rec::Record));
+                    if (record.site >= state.sites.size() or not state.sites[record.site]) {
+                        return false;    // a site is always described before its first record
+                    }
+                    list.push_back({
+                        .site   = *state.sites[record.site],
+                        .flags  = static_cast<std::uint8_t>(record.flags),
+                        .depth  = static_cast<std::uint8_t>(record.flags >> 8),
+                        .weight = std::max(static_cast<std::uint16_t>(record.flags >> 16), std::uint16_t{ 1 }),
+                        .start  = record.start,
+                        .end    = record.end,
+                    });
+                }
+                list.flush();
+                state.records += block.count;
+            }
+
+            offset += sizeof(rec::ChunkHeader) + rec::padded(chunk.size);
+        }
+        return true;
+    }
+}
+
+int main()
+{
+    constexpr auto calls = 1000u;
+    constexpr auto path  = "recorder-test.ascopet";
+
+    auto* ascopet = ascopet::init({
+        .immediately_start = true,
+        .poll_interval     = 10ms,
+        .record_capacity   = 4 * calls,
+        .buffer_capacity   = 4096,
+    });
+
+    // small blocks so the records span many of them
+    if (not ascopet->start_recording({ .path = path, .block_records = 64 })) {
+        std::fprintf(stderr, "FAILED: can't record to %s\n", path);
+        return 1;
+    }
+
+    std::thread{ [] {
+        for (auto i = 0u; i < calls; ++i) {
+            auto outer = ascopet::trace<"recorder/outer">();
+            for (auto j = 0; j < 2; ++j) {
+                auto inner = ascopet::trace<"recorder/inner">();
+            }
+        }
+    } }.join();
+
+    // an exited thread is reported alive until the worker has drained what it left
+    auto traced = std::optional<std::pair<std::thread::id, std::uint64_t>>{};
+    for (auto i = 0; i < 200 and not traced; ++i) {
+        for (const auto& [id, info] : ascopet->thread_report()) {
+            if (not info.alive) {
+                traced = std::pair{ id, info.tid };
+            }
+        }
+        if (not traced) {
+            std::this_thread::sleep_for(10ms);
+        }
+    }
+    ascopet->stop_recording();
+
+    if (not traced) {
+        std::fprintf(stderr, "FAILED: the thread was never settled\n");
+        return 1;
+    }
+
+    auto file = std::ifstream{ path, std::ios::binary };
+    auto data = std::vector<char>{ std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{} };
+    file.close();
+    std::remove(path);
+
+    auto list  = ascopet::TimingList{ 4 * calls };
+    auto state = Replay{};
+    if (not replay(data, list, state)) {
+        std::fprintf(stderr, "FAILED: the file isn't a valid recording\n");
+        return 1;
+    }
+
+    check(state.header.version == rec::version, "version of the file", state.header.version);
+    check(state.header.tsc_freq == ascopet->tsc_freq(), "tsc frequency of the file", state.header.tsc_freq);
+    check(state.records == 3 * calls, "records in the file", state.records);
+    check(state.tids.size() == 1 and state.tids.front() == traced->second, "threads in the file", state.tids.size());
+
+    auto report   = ascopet->report();
+    auto replayed = list.stat(state.header.tsc_freq);
+    for (const auto* name : { "recorder/outer", "recorder/inner" }) {
+        const auto& live = report[traced->first][name];
+        const auto& read = replayed[name];
+        check(read.count == live.count, name, read.count);
+        check(read.duration.min == live.duration.min, name, static_cast<std::uint64_t>(read.duration.min.count()));
+        check(read.duration.max == live.duration.max, name, static_cast<std::uint64_t>(read.duration.max.count()));
+        check(
+            std::abs(read.duration.mean.count() - live.duration.mean.count()) < 1e-6,
+            name,
+            static_cast<std::uint64_t>(read.duration.mean.count())
+        );
+    }
+
+    return g_failures == 0 ? 0 : 1;
+}
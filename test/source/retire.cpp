@@ -0,0 +1,104 @@
+// Threads that exit are merged into the retired entry with their records, so the retired stats lose nothing
+// that a live thread wouldn't: the records still in their windows count as in the window, where the exact median
+// is taken, and a report_since cursor sees them as new.
+
+#include <ascopet/ascopet.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+    int g_failures = 0;
+
+    void check(bool ok, const char* what, std::uint64_t value)
+    {
+        if (not ok) {
+            std::fprintf(stderr, "FAILED: %s (got %llu)\n", what, static_cast<unsigned long long>(value));
+            ++g_failures;
+        }
+    }
+
+    void run(std::size_t calls)
+    {
+        auto thread = std::thread{ [calls] {
+            for (auto i = 0u; i < calls; ++i) {
+                auto tracer = ascopet::trace<"retire/scope">();
+            }
+        } };
+        thread.join();
+    }
+
+    // the retired entry, once it holds `sampled` records
+    const ascopet::TimingStat* retired(const ascopet::Report& report, std::uint64_t sampled)
+    {
+        if (auto thread = report.find(std::thread::id{}); thread != report.end()) {
+            if (auto entry = thread->second.find("retire/scope"); entry != thread->second.end()) {
+                return entry->second.sampled == sampled ? &entry->second : nullptr;
+            }
+        }
+        return nullptr;
+    }
+}
+
+int main()
+{
+    constexpr auto capacity = std::size_t{ 1024 };
+
+    auto* ascopet = ascopet::init({
+        .immediately_start = true,
+        .poll_interval     = 10ms,
+        .record_capacity   = capacity,
+        .buffer_capacity   = 4096,    // so the tls buffers don't overwrite records before the worker drains them
+        .retire            = ascopet::Retire::merge,
+        .retire_ttl        = ascopet::Duration::zero(),
+    });
+
+    run(100);
+    run(2000);
+
+    // a thread retires on the first poll of the worker after it exited
+    auto report = ascopet::Report{};
+    for (auto i = 0; i < 200 and retired(report, 2100) == nullptr; ++i) {
+        std::this_thread::sleep_for(10ms);
+        report = ascopet->report(true);
+    }
+
+    const auto* stat = retired(report, 2100);
+    if (stat == nullptr) {
+        std::fprintf(stderr, "FAILED: the threads were never retired\n");
+        return 1;
+    }
+
+    // the window of the retired entry holds the 1024 latest of the 100 + 1024 records still in the windows
+    check(stat->count == 2100, "count of the retired entry", stat->count);
+    check(stat->overwritten == 2100 - capacity, "overwritten records of the retired entry", stat->overwritten);
+
+    auto cursor = ascopet::ReportCursor{};
+    auto since  = ascopet->report_since(cursor);
+    if (const auto* fresh = retired(since, 2100); fresh != nullptr) {
+        check(fresh->count == 2100, "count of the retired entry since the start", fresh->count);
+        check(fresh->overwritten == 2100 - capacity, "overwritten records since the start", fresh->overwritten);
+    } else {
+        std::fprintf(stderr, "FAILED: report_since doesn't see the retired records\n");
+        ++g_failures;
+    }
+
+    run(10);
+    for (auto i = 0; i < 200 and retired(since, 10) == nullptr; ++i) {
+        std::this_thread::sleep_for(10ms);
+        since = ascopet->report_since(cursor);
+    }
+    if (const auto* fresh = retired(since, 10); fresh != nullptr) {
+        check(fresh->count == 10, "count of the retired entry since the last report", fresh->count);
+        check(fresh->overwritten == 0, "overwritten records since the last report", fresh->overwritten);
+    } else {
+        std::fprintf(stderr, "FAILED: report_since doesn't see the records retired since the last report\n");
+        ++g_failures;
+    }
+
+    return g_failures == 0 ? 0 : 1;
+}
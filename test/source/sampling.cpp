@@ -0,0 +1,101 @@
+// A sampled site only times one call out of `every` but still counts every call: the record of a sampled call
+// stands for the calls skipped before it, so `count` is the number of calls (but for those after the last
+// sample) and `sampled` the number of records, whether the gap is fixed or random. A disabled site isn't
+// counted at all.
+
+#include <ascopet/ascopet.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+    int g_failures = 0;
+
+    void check(bool ok, const char* what, std::uint64_t value)
+    {
+        if (not ok) {
+            std::fprintf(stderr, "FAILED: %s (got %llu)\n", what, static_cast<unsigned long long>(value));
+            ++g_failures;
+        }
+    }
+}
+
+int main()
+{
+    constexpr auto every = 10u;
+    constexpr auto calls = 10'000u;
+
+    // a record with a weight stands for that many calls
+    {
+        auto site = ascopet::register_site("sampling/list");
+        auto list = ascopet::TimingList{ 64 };
+        for (auto i = 0u; i < 10; ++i) {
+            list.push_back({ .site = site, .weight = every, .start = i * 100, .end = i * 100 + 10 });
+        }
+        list.flush();
+
+        auto stat = list.stat(1'000'000'000)["sampling/list"];
+        check(stat.count == 10 * every, "calls of weighted records", stat.count);
+        check(stat.sampled == 10, "records of weighted records", stat.sampled);
+    }
+
+    auto* ascopet = ascopet::init({
+        .immediately_start = true,
+        .poll_interval     = 10ms,
+        .buffer_capacity   = 4096,
+    });
+
+    auto fixed    = ascopet::register_site("sampling/fixed");
+    auto random   = ascopet::register_site("sampling/random");
+    auto disabled = ascopet::register_site("sampling/disabled");
+    ascopet::set_sampling(fixed, { .every = every });
+    ascopet::set_sampling(random, { .every = every, .random = true });
+    ascopet::set_enabled(disabled, false);
+
+    std::thread{ [&] {
+        for (auto i = 0u; i < calls; ++i) {
+            auto a = ascopet::trace(fixed);
+            auto b = ascopet::trace(random);
+            auto c = ascopet::trace(disabled);
+        }
+    } }.join();
+
+    // an exited thread is reported alive until the worker has drained what it left
+    auto settled = [&] {
+        auto report = ascopet->thread_report();
+        return std::ranges::none_of(report, [](const auto& entry) { return entry.second.alive; });
+    };
+    for (auto i = 0; i < 200 and not settled(); ++i) {
+        std::this_thread::sleep_for(10ms);
+    }
+
+    auto report = ascopet->aggregate_report();
+
+    // with a fixed gap every `every`-th call is the sampled one, so the last one is
+    const auto& fixed_stat = report["sampling/fixed"];
+    check(fixed_stat.count == calls, "calls of a fixed sampling", fixed_stat.count);
+    check(fixed_stat.sampled == calls / every, "records of a fixed sampling", fixed_stat.sampled);
+
+    // a random gap is at most 2 * every - 1, the calls after the last sample aren't counted yet
+    const auto& random_stat = report["sampling/random"];
+    check(
+        random_stat.count <= calls and random_stat.count > calls - 2 * every,
+        "calls of a random sampling",
+        random_stat.count
+    );
+    check(
+        random_stat.sampled > calls / every * 8 / 10 and random_stat.sampled < calls / every * 12 / 10,
+        "records of a random sampling",
+        random_stat.sampled
+    );
+
+    auto off = report.find("sampling/disabled");
+    check(off == report.end(), "calls of a disabled site", off != report.end() ? off->second.count : 0);
+
+    return g_failures == 0 ? 0 : 1;
+}
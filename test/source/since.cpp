@@ -0,0 +1,134 @@
+// A cursor only reads what was pushed since its last read: the entries without new records are left out, the
+// stats cover just the new records, records that no longer fit in the window are only counted, and every
+// cursor reads the same records whatever the other ones already read.
+
+#include <ascopet/ascopet.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+    int g_failures = 0;
+
+    void check(bool ok, const char* what, std::uint64_t value)
+    {
+        if (not ok) {
+            std::fprintf(stderr, "FAILED: %s (got %llu)\n", what, static_cast<unsigned long long>(value));
+            ++g_failures;
+        }
+    }
+
+    // with one tick per ns the durations are the ticks
+    constexpr auto freq = std::uint64_t{ 1'000'000'000 };
+
+    std::uint64_t g_clock = 1000;
+
+    void push(ascopet::TimingList& list, ascopet::SiteId site, std::uint64_t duration, std::size_t count)
+    {
+        for (auto i = 0u; i < count; ++i, g_clock += 100) {
+            list.push_back({ .site = site, .start = g_clock, .end = g_clock + duration });
+        }
+        list.flush();
+    }
+
+    // entry of `name` with `count` records of `mean` ns, or none at all with a count of 0
+    void expect(const ascopet::StrMap<ascopet::TimingStat>& stats, const char* name, std::size_t count, double mean)
+    {
+        auto it = stats.find(name);
+        if (count == 0) {
+            check(it == stats.end(), name, it != stats.end() ? it->second.count : 0);
+            return;
+        }
+        if (it == stats.end()) {
+            std::fprintf(stderr, "FAILED: no new records of %s\n", name);
+            ++g_failures;
+            return;
+        }
+        check(it->second.count == count, name, it->second.count);
+        auto got = it->second.duration.mean.count();
+        check(std::abs(got - mean) < 1e-6, name, static_cast<std::uint64_t>(got));
+    }
+
+    // the records the main thread traced since `cursor` last read, polled until `expected` were drained
+    std::size_t drained_since(ascopet::Ascopet& ascopet, ascopet::ReportCursor& cursor, std::size_t expected)
+    {
+        auto count = std::size_t{ 0 };
+        for (auto i = 0; i < 200 and count < expected; ++i) {
+            for (const auto& [_, stats] : ascopet.report_since(cursor)) {
+                if (auto it = stats.find("since/scope"); it != stats.end()) {
+                    count += it->second.count;
+                }
+            }
+            if (count < expected) {
+                std::this_thread::sleep_for(10ms);
+            }
+        }
+        return count;
+    }
+}
+
+int main()
+{
+    auto a = ascopet::register_site("since/a");
+    auto b = ascopet::register_site("since/b");
+
+    auto list   = ascopet::TimingList{ 8 };
+    auto first  = ascopet::TimingList::Cursor{};
+    auto second = ascopet::TimingList::Cursor{};
+
+    push(list, a, 10, 3);
+    auto stats = list.stat_since(freq, first);
+    expect(stats, "since/a", 3, 10.0);
+    expect(stats, "since/b", 0, 0.0);
+
+    push(list, a, 30, 2);
+    push(list, b, 5, 1);
+    stats = list.stat_since(freq, first);
+    expect(stats, "since/a", 2, 30.0);
+    expect(stats, "since/b", 1, 5.0);
+
+    stats = list.stat_since(freq, first);
+    check(stats.empty(), "entries of a cursor with nothing new", stats.size());
+
+    // the second cursor never read, everything is new to it
+    stats = list.stat_since(freq, second);
+    expect(stats, "since/a", 5, (3 * 10.0 + 2 * 30.0) / 5);
+    expect(stats, "since/b", 1, 5.0);
+
+    // more new records than the window holds: all counted, the stats from the 8 still in it
+    push(list, a, 7, 20);
+    stats = list.stat_since(freq, first);
+    expect(stats, "since/a", 20, 7.0);
+    if (auto it = stats.find("since/a"); it != stats.end()) {
+        check(it->second.overwritten == 12, "overwritten new records", it->second.overwritten);
+    }
+
+    // the same through the instance, with one cursor per consumer
+    auto* ascopet = ascopet::init({
+        .immediately_start = true,
+        .poll_interval     = 10ms,
+    });
+
+    auto dashboard = ascopet::ReportCursor{};
+    auto logger    = ascopet::ReportCursor{};
+    for (auto i = 0; i < 5; ++i) {
+        auto tracer = ascopet::trace<"since/scope">();
+    }
+    auto read = drained_since(*ascopet, dashboard, 5);
+    check(read == 5, "records of the first read", read);
+
+    for (auto i = 0; i < 3; ++i) {
+        auto tracer = ascopet::trace<"since/scope">();
+    }
+    read = drained_since(*ascopet, dashboard, 3);
+    check(read == 3, "records new to the first cursor", read);
+    read = drained_since(*ascopet, logger, 8);
+    check(read == 8, "records new to the second cursor", read);
+
+    return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,160 @@
+// The tls ring buffer loses records only in ways it accounts for: on its own, every record pushed is either
+// consumed, in order, or counted as overwritten, even while the producer moves the head concurrently with the
+// consumer; through the library, with the default Overflow::overwrite and a buffer far too small for the load,
+// `produced == drained + overwritten + dropped` holds and the reports count exactly the drained records.
+
+#include <ascopet/ascopet.hpp>
+#include <ascopet/spscbuf.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <latch>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+    int g_failures = 0;
+
+    void check(bool ok, const char* what, std::uint64_t value)
+    {
+        if (not ok) {
+            std::fprintf(stderr, "FAILED: %s (got %llu)\n", what, static_cast<unsigned long long>(value));
+            ++g_failures;
+        }
+    }
+
+    void single_thread()
+    {
+        auto buffer = ascopet::SpscBuf<std::uint64_t>{ 8, 6 };
+
+        auto results = std::vector<ascopet::Push>{};
+        for (auto i = 0u; i < 9; ++i) {
+            results.push_back(buffer.push(i));
+        }
+        check(results[5] == ascopet::Push::pushed, "push below the watermark", 5);
+        check(results[6] == ascopet::Push::crossed, "push reaching the watermark", 6);
+        check(results[7] == ascopet::Push::pushed, "push filling the buffer", 7);
+        check(results[8] == ascopet::Push::full, "push into a full buffer", 8);
+
+        // the 8 records are 0 to 7, the next 3 discard 0 to 2
+        auto overwritten = 0u;
+        for (auto i = 8u; i < 11; ++i) {
+            overwritten += buffer.push_overwrite(i);
+        }
+        check(overwritten == 3, "records discarded by push_overwrite", overwritten);
+
+        auto next = std::uint64_t{ 3 };
+        auto kept = buffer.consume([&](std::uint64_t value) { check(value == next++, "record consumed", value); });
+        check(kept == 8, "records consumed after overwriting", kept);
+        check(buffer.size() == 0, "records left after consuming", buffer.size());
+    }
+
+    // the producer overwrites as fast as it can while the consumer drains, so the head is moved by both
+    void concurrent()
+    {
+        constexpr auto count = std::uint64_t{ 2'000'000 };
+
+        auto buffer      = ascopet::SpscBuf<std::uint64_t>{ 16 };
+        auto done        = std::atomic<bool>{ false };
+        auto overwritten = std::uint64_t{ 0 };
+
+        auto producer = std::thread{ [&] {
+            for (auto i = std::uint64_t{ 0 }; i < count; ++i) {
+                overwritten += buffer.push_overwrite(i);
+            }
+            done.store(true);
+        } };
+
+        auto consumed = std::uint64_t{ 0 };
+        auto ordered  = true;
+        auto last     = std::uint64_t{ 0 };
+        auto consumer = [&](std::uint64_t value) {
+            ordered = ordered and (consumed == 0 or value > last);
+            last    = value;
+            ++consumed;
+        };
+        while (not done.load()) {
+            buffer.consume(consumer);
+        }
+        producer.join();
+        buffer.consume(consumer);
+
+        check(ordered, "records consumed in order", last);
+        check(overwritten > 0, "records overwritten while consuming", overwritten);
+        check(consumed + overwritten == count, "records consumed or overwritten", consumed + overwritten);
+    }
+
+    void through_library()
+    {
+        constexpr auto threads = 4u;
+        constexpr auto calls   = 200'000u;
+
+        auto* ascopet = ascopet::init({
+            .immediately_start = true,
+            .poll_interval     = 1ms,
+            .buffer_capacity   = 64,
+        });
+
+        // the stats of a thread's buffer are only reported while it is alive
+        auto traced  = std::latch{ threads };
+        auto checked = std::latch{ 1 };
+        auto workers = std::vector<std::jthread>{};
+        for (auto i = 0u; i < threads; ++i) {
+            workers.emplace_back([&] {
+                for (auto j = 0u; j < calls; ++j) {
+                    auto tracer = ascopet::trace<"ring/scope">();
+                }
+                traced.count_down();
+                checked.wait();
+            });
+        }
+        traced.wait();
+
+        auto settled = [&] {
+            auto buffers = ascopet->buffer_report();
+            for (const auto& [_, stat] : buffers) {
+                if (stat.produced != stat.drained + stat.overwritten + stat.dropped) {
+                    return false;
+                }
+            }
+            return buffers.size() >= threads;
+        };
+        for (auto i = 0; i < 500 and not settled(); ++i) {
+            std::this_thread::sleep_for(10ms);
+        }
+        check(settled(), "produced == drained + overwritten + dropped", 0);
+
+        auto buffers = ascopet->buffer_report();
+        auto report  = ascopet->report();
+        auto total   = std::uint64_t{ 0 };
+        for (const auto& [id, stat] : buffers) {
+            auto thread = report.find(id);
+            auto entry  = thread == report.end() ? nullptr : &thread->second;
+            if (entry == nullptr or not entry->contains("ring/scope")) {
+                continue;
+            }
+
+            total += stat.overwritten;
+            check(stat.produced == calls, "records produced by a thread", stat.produced);
+            check(stat.dropped == 0, "records dropped with Overflow::overwrite", stat.dropped);
+            check(entry->at("ring/scope").count == stat.drained, "reported count of a thread", stat.drained);
+        }
+        check(total > 0, "records overwritten in the tls buffers", total);
+
+        checked.count_down();
+    }
+}
+
+int main()
+{
+    single_thread();
+    concurrent();
+    through_library();
+
+    return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,84 @@
+// A time window only reports the records that started within its span before `now`: a bucket is dropped once it
+// falls out of the span, an entry with no bucket left is left out, and a recycled bucket doesn't carry the
+// records of the epoch it held before.
+
+#include <ascopet/ascopet.hpp>
+
+#include <cmath>
+#include <cstdio>
+
+namespace
+{
+    int g_failures = 0;
+
+    void check(bool ok, const char* what, std::uint64_t value)
+    {
+        if (not ok) {
+            std::fprintf(stderr, "FAILED: %s (got %llu)\n", what, static_cast<unsigned long long>(value));
+            ++g_failures;
+        }
+    }
+
+    // with one tick per ns the durations are the ticks
+    constexpr auto freq = std::uint64_t{ 1'000'000'000 };
+
+    // a window of 1000 ticks in 4 buckets of 250
+    constexpr auto span    = std::uint64_t{ 1000 };
+    constexpr auto buckets = std::size_t{ 4 };
+
+    void push(ascopet::TimingList& list, ascopet::SiteId site, std::uint64_t start, std::uint64_t duration, int count)
+    {
+        for (auto i = 0; i < count; ++i, ++start) {
+            list.push_back({ .site = site, .start = start, .end = start + duration });
+        }
+        list.flush();
+    }
+
+    // count of the records in the window ending at `now`, 0 if the entry was left out
+    std::size_t in_window(const ascopet::TimingList& list, std::uint64_t now, double* mean = nullptr)
+    {
+        auto stats = list.window_stat(freq, 0, now);
+        auto it    = stats.find("window/scope");
+        if (it == stats.end()) {
+            return 0;
+        }
+        if (mean) {
+            *mean = it->second.duration.mean.count();
+        }
+        return it->second.count;
+    }
+}
+
+int main()
+{
+    auto site = ascopet::register_site("window/scope");
+    auto list = ascopet::TimingList{ 1024, { span }, buckets };
+
+    push(list, site, 100, 10, 10);    // epoch 0
+    push(list, site, 600, 20, 5);     // epoch 2
+
+    auto mean  = 0.0;
+    auto count = in_window(list, 700, &mean);
+    check(count == 15, "records in the window", count);
+    check(std::abs(mean - (10 * 10.0 + 5 * 20.0) / 15) < 1e-6, "mean of the window", static_cast<std::uint64_t>(mean));
+
+    // at epoch 4 the window covers epochs 1 to 4, the bucket of epoch 0 is out
+    count = in_window(list, 1100, &mean);
+    check(count == 5, "records once the oldest bucket is out", count);
+    check(std::abs(mean - 20.0) < 1e-6, "mean once the oldest bucket is out", static_cast<std::uint64_t>(mean));
+
+    // at epoch 6 every bucket is out
+    count = in_window(list, 1600, &mean);
+    check(count == 0, "records once every bucket is out", count);
+
+    // epoch 6 takes the slot of epoch 2, whose records must not come back with it
+    push(list, site, 1550, 30, 3);
+    count = in_window(list, 1600, &mean);
+    check(count == 3, "records of a recycled bucket", count);
+    check(std::abs(mean - 30.0) < 1e-6, "mean of a recycled bucket", static_cast<std::uint64_t>(mean));
+
+    auto stats = list.window_stat(freq, 1, 1600);
+    check(stats.empty(), "entries of a window that wasn't configured", stats.size());
+
+    return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,356 @@
+#include <ascopet/ascopet.hpp>
+#include <ascopet/recording.hpp>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace rec = ascopet::recording;
+
+using Us = std::chrono::duration<double, std::micro>;
+
+// No println in C++20 yet
+template <typename... Args>
+void println(std::ostream& out, std::format_string<Args...> fmt, Args&&... args)
+{
+    out << std::format(fmt, std::forward<Args>(args)...) << '\n';
+}
+
+struct Options
+{
+    std::vector<std::string> files;
+    std::size_t              record_capacity   = 1024;
+    bool                     subtract_overhead = false;
+    bool                     folded            = false;    // print folded stacks instead of the stats
+};
+
+struct Thread
+{
+    std::uint64_t       tid;
+    std::string         name;
+    ascopet::TimingList list;
+};
+
+// state shared by every file of a rotation
+struct Replay
+{
+    std::uint64_t                               tsc_freq = 0;
+    std::vector<std::optional<ascopet::SiteId>> sites;    // recorded site id -> site id in this process
+    std::map<std::uint32_t, Thread>             threads;
+    std::uint64_t                               records = 0;
+};
+
+void print_usage(const char* program)
+{
+    println(
+        std::cerr,
+        "usage: {} [--record N] [--subtract-overhead] [--folded] FILE...\n\n"
+        "Replays recordings made with Ascopet::start_recording through the same stats as Ascopet::report.\n"
+        "The files of a rotation must be given in order. --record sets the record window of every entry.\n"
+        "--folded prints the call trees of every thread as folded stacks (self time in ns) instead.",
+        program
+    );
+}
+
+bool parse_options(int argc, char** argv, Options& options)
+{
+    for (auto i = 1; i < argc; ++i) {
+        auto arg = std::string_view{ argv[i] };
+        if (arg == "--help") {
+            return false;
+        } else if (arg == "--subtract-overhead") {
+            options.subtract_overhead = true;
+        } else if (arg == "--folded") {
+            options.folded = true;
+        } else if (arg == "--record" and i + 1 < argc) {
+            auto value     = std::string_view{ argv[++i] };
+            auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), options.record_capacity);
+            if (ec != std::errc{} or ptr != value.data() + value.size() or options.record_capacity == 0) {
+                return false;
+            }
+        } else {
+            options.files.emplace_back(arg);
+        }
+    }
+    return not options.files.empty();
+}
+
+template <typename T>
+T load(const std::byte* at)
+{
+    auto value = T{};
+    std::memcpy(&value, at, sizeof(T));
+    return value;
+}
+
+// whether the fixed part of a chunk and the lengths it gives for the rest fit in its size
+bool well_formed(const rec::ChunkHeader& chunk, const std::byte* payload)
+{
+    auto fits = [&](std::size_t fixed, std::uint64_t rest) {
+        return fixed <= chunk.size and rest <= chunk.size - fixed;
+    };
+
+    switch (chunk.kind) {
+    case rec::ChunkKind::site: {
+        return fits(sizeof(rec::SiteChunk), 0) and fits(sizeof(rec::SiteChunk), load<rec::SiteChunk>(payload).length);
+    }
+    case rec::ChunkKind::thread: {
+        return fits(sizeof(rec::ThreadChunk), 0)
+           and fits(sizeof(rec::ThreadChunk), load<rec::ThreadChunk>(payload).length);
+    }
+    case rec::ChunkKind::records: {
+        if (not fits(sizeof(rec::RecordsChunk), 0)) {
+            return false;
+        }
+        auto count = std::uint64_t{ load<rec::RecordsChunk>(payload).count };
+        return fits(sizeof(rec::RecordsChunk), count * sizeof(rec::Record));
+    }
+    default: return true;
+    }
+}
+
+// feeds every record of a mapped file into the lists of its threads, false if it isn't a recording
+bool replay(const std::byte* data, std::size_t size, const Options& options, Replay& state)
+{
+    if (size < sizeof(rec::FileHeader)) {
+        return false;
+    }
+
+    auto header = load<rec::FileHeader>(data);
+    if (std::memcmp(header.magic, rec::magic, sizeof(rec::magic)) != 0 or header.version != rec::version) {
+        return false;
+    } else if (state.tsc_freq != 0 and state.tsc_freq != header.tsc_freq) {
+        println(std::cerr, "files recorded at different tsc frequencies can't be mixed");
+        return false;
+    }
+    state.tsc_freq = header.tsc_freq;
+
+    auto overhead = [&](std::uint32_t flags) -> std::uint64_t {
+        if (not options.subtract_overhead) {
+            return 0;
+        }
+        auto serialized = (flags & ascopet::NamedRecord::serialized) != 0;
+        return serialized ? header.serialized_overhead : header.overhead;
+    };
+
+    auto offset = rec::padded(sizeof(rec::FileHeader));
+    while (offset + sizeof(rec::ChunkHeader) <= size) {
+        auto chunk   = load<rec::ChunkHeader>(data + offset);
+        auto payload = data + offset + sizeof(rec::ChunkHeader);
+
+        if (chunk.kind == rec::ChunkKind::end) {
+            break;
+        } else if (offset + sizeof(rec::ChunkHeader) + chunk.size > size) {
+            println(std::cerr, "truncated chunk at offset {}", offset);
+            break;
+        } else if (not well_formed(chunk, payload)) {
+            println(std::cerr, "malformed chunk at offset {}", offset);
+            break;
+        }
+
+        switch (chunk.kind) {
+        case rec::ChunkKind::site: {
+            auto site = load<rec::SiteChunk>(payload);
+            auto name = std::string_view{ reinterpret_cast<const char*>(payload + sizeof(site)), site.length };
+            if (site.site >= state.sites.size()) {
+                state.sites.resize(site.site + 1);
+            }
+            state.sites[site.site] = ascopet::register_site(name);
+        } break;
+
+        case rec::ChunkKind::thread: {
+            auto thread = load<rec::ThreadChunk>(payload);
+            auto name   = std::string{ reinterpret_cast<const char*>(payload + sizeof(thread)), thread.length };
+            auto list   = ascopet::TimingList{ options.record_capacity, {}, 1, options.folded };
+            state.threads.try_emplace(thread.thread, thread.tid, std::move(name), std::move(list));
+        } break;
+
+        case rec::ChunkKind::records: {
+            auto block  = load<rec::RecordsChunk>(payload);
+            auto thread = state.threads.find(block.thread);
+            if (thread == state.threads.end()) {
+                println(std::cerr, "records of an undescribed thread at offset {}", offset);
+                break;
+            }
+
+            auto& list = thread->second.list;
+            for (auto i = 0u; i < block.count; ++i) {
+                auto record = load<rec::Record>(payload + sizeof(block) + i * sizeof(rec::Record));
+                if (record.site >= state.sites.size() or not state.sites[record.site]) {
+                    continue;
+                }
+                auto named = ascopet::NamedRecord{
+                    .site   = *state.sites[record.site],
+                    .flags  = static_cast<std::uint8_t>(record.flags),
+                    .depth  = static_cast<std::uint8_t>(record.flags >> 8),
+                    .weight = std::max(static_cast<std::uint16_t>(record.flags >> 16), std::uint16_t{ 1 }),
+                    .start  = record.start,
+                    .end    = record.end,
+                };
+                list.push_back(named, overhead(record.flags));
+            }
+            list.flush();
+            state.records += block.count;
+        } break;
+
+        default: {
+            auto kind = static_cast<std::uint32_t>(chunk.kind);
+            println(std::cerr, "unknown chunk kind {} at offset {}", kind, offset);
+        } break;
+        }
+
+        offset += sizeof(rec::ChunkHeader) + rec::padded(chunk.size);
+    }
+
+    return true;
+}
+
+bool replay_file(const std::string& path, const Options& options, Replay& state)
+{
+    auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        println(std::cerr, "can't open {}: {}", path, std::strerror(errno));
+        return false;
+    }
+
+    struct stat st = {};
+    ::fstat(fd, &st);
+    auto size = static_cast<std::size_t>(st.st_size);
+
+    auto* map = size > 0 ? ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        println(std::cerr, "can't map {}", path);
+        return false;
+    }
+
+    auto ok = replay(static_cast<const std::byte*>(map), size, options, state);
+    ::munmap(map, size);
+
+    if (not ok) {
+        println(std::cerr, "{} is not an ascopet recording", path);
+    }
+    return ok;
+}
+
+void print_stat(std::string_view label, const ascopet::TimingStat::Stat& stat)
+{
+    println(
+        std::cout,
+        "\t\t> {} [ mean: {:.3f} (+/- {:.3f}) | median: {:.3f} | min: {:.3f} | max: {:.3f} | p99: {:.3f} | "
+        "p99.9: {:.3f} ] us",
+        label,
+        Us{ stat.mean }.count(),
+        Us{ stat.stdev }.count(),
+        Us{ stat.median }.count(),
+        Us{ stat.min }.count(),
+        Us{ stat.max }.count(),
+        Us{ stat.p99 }.count(),
+        Us{ stat.p999 }.count()
+    );
+}
+
+void print_counter(std::string_view name, const ascopet::CounterStat& counter)
+{
+    switch (counter.kind) {
+    case ascopet::NamedRecord::counter:
+        println(std::cout, "\t> {} [ counter | sum: {} | rate: {:.3f} /s ]", name, counter.sum, counter.rate);
+        break;
+    case ascopet::NamedRecord::gauge:
+        println(
+            std::cout,
+            "\t> {} [ gauge | last: {} | mean: {:.3f} | min: {} | max: {} ]",
+            name,
+            counter.last,
+            counter.mean,
+            counter.min,
+            counter.max
+        );
+        break;
+    default: println(std::cout, "\t> {} [ event | count: {} | rate: {:.3f} /s ]", name, counter.count, counter.rate);
+    }
+
+    for (const auto& [scope, throughput] : counter.scopes) {
+        println(
+            std::cout,
+            "\t\t> in {}: {} over {:.3f} us, {:.3f} /s",
+            scope,
+            throughput.sum,
+            Us{ throughput.time }.count(),
+            throughput.per_second
+        );
+    }
+}
+
+// same output as Ascopet::folded_stacks
+void print_folded(const Replay& state)
+{
+    auto ns_per_tick = 1e9 / static_cast<double>(state.tsc_freq);
+
+    auto stacks = std::map<std::string, double>{};
+    for (const auto& [_, thread] : state.threads) {
+        thread.list.calls().for_each_path([&](std::span<const ascopet::SiteId> path, const auto& node) {
+            auto stack = std::string{};
+            for (auto id : path) {
+                stack += stack.empty() ? "" : ";";
+                stack += ascopet::site(id).name;
+            }
+            stacks[std::move(stack)] += static_cast<double>(node.self) * ns_per_tick;
+        });
+    }
+
+    for (const auto& [stack, self] : stacks) {
+        if (auto ns = static_cast<std::uint64_t>(self); ns > 0) {
+            println(std::cout, "{} {}", stack, ns);
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    auto options = Options{};
+    if (not parse_options(argc, argv, options)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    auto state = Replay{};
+    for (const auto& file : options.files) {
+        if (not replay_file(file, options, state)) {
+            return 1;
+        }
+    }
+
+    if (options.folded) {
+        print_folded(state);
+        return 0;
+    }
+
+    println(std::cout, "{} records of {} threads in {} files", state.records, state.threads.size(), options.files.size());
+    for (const auto& [id, thread] : state.threads) {
+        println(std::cout, "\tThread {} (tid {}, {})", id, thread.tid, thread.name.empty() ? "unnamed" : thread.name);
+        for (const auto& [name, timing] : thread.list.stat(state.tsc_freq)) {
+            println(std::cout, "\t> {}", name);
+            print_stat("Dur  ", timing.duration);
+            print_stat("Intvl", timing.interval);
+            println(std::cout, "\t\t> Count: {} (sampled: {})", timing.count, timing.sampled);
+        }
+        for (const auto& [name, counter] : thread.list.counter_stat(state.tsc_freq)) {
+            print_counter(name, counter);
+        }
+    }
+}
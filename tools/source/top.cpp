@@ -0,0 +1,314 @@
+#include <ascopet/live.hpp>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <optional>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace live = ascopet::live;
+
+// No println in C++20 yet
+template <typename... Args>
+void println(std::ostream& out, std::format_string<Args...> fmt, Args&&... args)
+{
+    out << std::format(fmt, std::forward<Args>(args)...) << '\n';
+}
+
+enum class Sort
+{
+    total,
+    p99,
+    rate,
+};
+
+struct Options
+{
+    std::uint64_t              pid        = 0;
+    Sort                       sort       = Sort::total;
+    std::chrono::milliseconds  delay      = std::chrono::milliseconds{ 1000 };
+    std::optional<std::size_t> iterations = std::nullopt;    // forever by default
+    std::size_t                rows       = 40;
+};
+
+struct Snapshot
+{
+    std::uint64_t            published = 0;
+    std::uint64_t            omitted   = 0;
+    std::vector<live::Entry> entries;
+};
+
+struct Row
+{
+    const live::Entry*    entry;
+    std::optional<double> rate;    // calls per second since the previous snapshot
+};
+
+void print_usage(const char* program)
+{
+    println(
+        std::cerr,
+        "usage: {} [--sort total|p99|rate] [--delay MS] [-n ITERATIONS] [--rows N] PID\n\n"
+        "Shows the stats a process publishes with Ascopet::start_live, refreshed every --delay ms (1000 by\n"
+        "default). The rate is computed between two snapshots, so it shows up from the second refresh.",
+        program
+    );
+}
+
+template <typename T>
+bool parse_number(std::string_view value, T& out)
+{
+    auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), out);
+    return ec == std::errc{} and ptr == value.data() + value.size();
+}
+
+bool parse_options(int argc, char** argv, Options& options)
+{
+    auto has_pid = false;
+    for (auto i = 1; i < argc; ++i) {
+        auto arg  = std::string_view{ argv[i] };
+        auto next = [&] { return i + 1 < argc ? std::string_view{ argv[++i] } : std::string_view{}; };
+
+        if (arg == "--help") {
+            return false;
+        } else if (arg == "--sort") {
+            auto value = next();
+            if (value == "total") {
+                options.sort = Sort::total;
+            } else if (value == "p99") {
+                options.sort = Sort::p99;
+            } else if (value == "rate") {
+                options.sort = Sort::rate;
+            } else {
+                return false;
+            }
+        } else if (arg == "--delay") {
+            auto ms = 0u;
+            if (not parse_number(next(), ms) or ms == 0) {
+                return false;
+            }
+            options.delay = std::chrono::milliseconds{ ms };
+        } else if (arg == "-n") {
+            auto count = std::size_t{ 0 };
+            if (not parse_number(next(), count) or count == 0) {
+                return false;
+            }
+            options.iterations = count;
+        } else if (arg == "--rows") {
+            if (not parse_number(next(), options.rows)) {
+                return false;
+            }
+        } else if (not has_pid and parse_number(arg, options.pid)) {
+            has_pid = true;
+        } else {
+            return false;
+        }
+    }
+    return has_pid;
+}
+
+// maps the segment of the process read-only, null if it has none or it isn't a live stats segment
+const std::byte* attach(std::uint64_t pid, std::size_t& size)
+{
+    auto name = live::segment_name(pid);
+    auto fd   = ::shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        println(std::cerr, "can't open {}: {} (is the process calling start_live?)", name, std::strerror(errno));
+        return nullptr;
+    }
+
+    struct stat st = {};
+    ::fstat(fd, &st);
+    size = static_cast<std::size_t>(st.st_size);
+
+    auto* map = size >= sizeof(live::Header) ? ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        println(std::cerr, "can't map {}", name);
+        return nullptr;
+    }
+
+    auto* header = static_cast<const live::Header*>(map);
+    auto  valid  = std::memcmp(header->magic, live::magic, sizeof(live::magic)) == 0
+               and header->version == live::version and live::segment_size(header->capacity) <= size;
+    if (not valid) {
+        println(std::cerr, "{} is not an ascopet live stats segment of a supported version", name);
+        ::munmap(map, size);
+        return nullptr;
+    }
+    return static_cast<const std::byte*>(map);
+}
+
+// copies the last snapshot out of the seqlock, false if the publisher kept rewriting it
+bool read_snapshot(const std::byte* map, Snapshot& snapshot)
+{
+    constexpr auto max_attempts = 1000;
+
+    const auto* header = reinterpret_cast<const live::Header*>(map);
+    for (auto attempt = 0; attempt < max_attempts; ++attempt) {
+        auto before = header->sequence.load(std::memory_order::acquire);
+        if (before % 2 != 0) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        auto count = std::min<std::uint64_t>(header->count, header->capacity);
+        snapshot.published = header->published;
+        snapshot.omitted   = header->omitted;
+        snapshot.entries.resize(count);
+        std::memcpy(snapshot.entries.data(), map + sizeof(live::Header), count * sizeof(live::Entry));
+
+        std::atomic_thread_fence(std::memory_order::acquire);
+        if (header->sequence.load(std::memory_order::relaxed) == before) {
+            for (auto& entry : snapshot.entries) {
+                entry.name[live::name_length - 1] = '\0';
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+// calls per second of each entry since the previous snapshot, none for the first one
+std::vector<Row> make_rows(const Snapshot& current, const Snapshot& previous)
+{
+    auto counts = std::unordered_map<std::string_view, std::uint64_t>{};
+    for (const auto& entry : previous.entries) {
+        counts.emplace(entry.name, entry.count);
+    }
+
+    auto elapsed = static_cast<double>(current.published - previous.published) / 1e9;
+    auto rows    = std::vector<Row>{};
+    for (const auto& entry : current.entries) {
+        auto row = Row{ &entry, std::nullopt };
+        if (auto it = counts.find(entry.name); it != counts.end() and elapsed > 0 and entry.count >= it->second) {
+            row.rate = static_cast<double>(entry.count - it->second) / elapsed;
+        }
+        rows.push_back(row);
+    }
+    return rows;
+}
+
+void sort_rows(std::vector<Row>& rows, Sort sort)
+{
+    auto key = [sort](const Row& row) {
+        switch (sort) {
+        case Sort::total: return row.entry->total;
+        case Sort::p99: return row.entry->p99;
+        case Sort::rate: return row.rate.value_or(-1.0);
+        }
+        return 0.0;
+    };
+    std::stable_sort(rows.begin(), rows.end(), [&](const Row& a, const Row& b) { return key(a) > key(b); });
+}
+
+void render(const Options& options, const Snapshot& snapshot, std::vector<Row>& rows, bool clear)
+{
+    constexpr const char* sort_names[] = { "total", "p99", "rate" };
+
+    auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()
+    );
+    auto age = static_cast<double>(now.count() - static_cast<std::int64_t>(snapshot.published)) / 1e6;
+
+    sort_rows(rows, options.sort);
+
+    if (clear) {
+        std::cout << "\x1b[H\x1b[2J";
+    }
+    println(
+        std::cout,
+        "ascopet-top - pid {} | {} entries ({} omitted) | snapshot {:.0f} ms old | sorted by {}\n",
+        options.pid,
+        snapshot.entries.size(),
+        snapshot.omitted,
+        age,
+        sort_names[static_cast<int>(options.sort)]
+    );
+    println(
+        std::cout,
+        "{:<40} {:>12} {:>12} {:>12} {:>10} {:>10} {:>10} {:>10}",
+        "NAME",
+        "CALLS",
+        "RATE/s",
+        "TOTAL ms",
+        "MEAN us",
+        "P50 us",
+        "P99 us",
+        "MAX us"
+    );
+
+    for (const auto& row : rows | std::views::take(options.rows)) {
+        const auto& entry = *row.entry;
+        auto        rate  = row.rate ? std::format("{:.1f}", *row.rate) : std::string{ "-" };
+        println(
+            std::cout,
+            "{:<40.40} {:>12} {:>12} {:>12.3f} {:>10.3f} {:>10.3f} {:>10.3f} {:>10.3f}",
+            std::string_view{ entry.name },
+            entry.count,
+            rate,
+            entry.total / 1e6,
+            entry.mean / 1e3,
+            entry.median / 1e3,
+            entry.p99 / 1e3,
+            entry.max / 1e3
+        );
+    }
+    std::cout << std::flush;
+}
+
+int main(int argc, char** argv)
+{
+    auto options = Options{};
+    if (not parse_options(argc, argv, options)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    auto size = std::size_t{ 0 };
+    auto map  = attach(options.pid, size);
+    if (map == nullptr) {
+        return 1;
+    }
+
+    auto clear    = ::isatty(STDOUT_FILENO) != 0;
+    auto current  = Snapshot{};
+    auto previous = Snapshot{};
+
+    for (auto i = std::size_t{ 0 }; not options.iterations or i < *options.iterations; ++i) {
+        if (i > 0) {
+            std::this_thread::sleep_for(options.delay);
+        }
+
+        // NOTE: a snapshot that wasn't republished since the last refresh keeps the rates of the last one
+        auto next = Snapshot{};
+        if (not read_snapshot(map, next)) {
+            println(std::cerr, "the segment kept changing while being read");
+            continue;
+        }
+        if (next.published != current.published) {
+            previous = std::move(current);
+            current  = std::move(next);
+        }
+
+        auto rows = make_rows(current, previous);
+        render(options, current, rows, clear);
+    }
+
+    ::munmap(const_cast<std::byte*>(map), size);
+}